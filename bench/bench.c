@@ -0,0 +1,856 @@
+// Benchmarks for ezview's image pipeline. Generates synthetic images of each size, times every
+// stage from parsing the header to drawing a frame, and writes the medians as JSON so compare.py
+// can check them against a baseline.
+//
+// Usage: ./ezview-bench [--sizes 1,16,64] [--repeat n] [--threads n] [--dir data] [--out results.json] [--no-gl]
+
+#include "../pnm.h"
+#include "../sampling.h"
+#include "../softrender.h"
+#include "../filter.h"
+#include "../glfilter.h"
+#include "../imageprog.h"
+#include "synth.h"
+#include "offscreen.h"
+#include "linbench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MAX_SIZES 16
+#define MAX_RESULTS 512
+//quick stages are run again until they have taken this long, so one slow run can't move the median
+#define MIN_STAGE_SECONDS 0.25
+#define MAX_RUNS 64
+//the frame the rendering stages draw, a typical full screen window
+#define FRAME_WIDTH 1920
+#define FRAME_HEIGHT 1080
+//header parses per run of the parse stage
+#define PARSE_ITERATIONS 1000000
+//small files in the directory the header reading stage goes through, the way a contact sheet does
+#define HEADER_FILES 1000
+//calls per run of each linmath routine
+#define LINMATH_ITERATIONS 10000000L
+//source rows are converted from a band this big, so it can't sit in cache between passes
+#define CONVERT_BAND_BYTES (64u << 20)
+
+//one line of the results, megapixels is 0 for stages that don't depend on the image
+typedef struct {
+  char stage[32];
+  double megapixels;
+  unsigned int width, height;
+  int runs;
+  double median, best;    //seconds
+  double bytes;           //processed per run, for a throughput figure
+  double ops;             //or things done per run, for a time per op
+  const char* skipped;    //why the stage didn't run, NULL if it did
+} BenchResult;
+
+//everything the stages share, for the image being benchmarked
+typedef struct {
+  double megapixels;
+  SynthImage synth;
+  char path[1024];
+  size_t imageBytes;        //8 bit RGB, width * height * 3
+  int repeat;
+  size_t memoryLimit;
+
+  unsigned char* image;
+  MipChain chain;
+  SoftImage soft;
+  SoftRenderer* renderer;
+  Framebuffer fb;
+  FilterChain filters;
+  unsigned char* filtered;
+  mat4x4 mvp;
+
+  //conversion from the other layouts, a band of source rows run over every output row
+  PnmHeader convertHeader;
+  unsigned char* band;
+  unsigned int bandRows;
+  unsigned char* converted;
+
+  unsigned char parseBuffer[PNM_MAX_HEADER];
+  size_t parseLength;
+  char headerDir[1024];
+
+  int gl;
+  GLint maxTexture;
+  ImageProgram prog;
+  GLuint vertexBuffer, EBO;
+  GLuint texture, fbo, colorBuffer;
+  Sampling sampling;
+  float scale, shear;
+  int mipmapped;            //0 to draw from level 0 alone, the baseline the mip chain is measured against
+  int hasGlFilter;
+  GlFilter glFilter;
+} Bench;
+
+static BenchResult results[MAX_RESULTS];
+static int resultCount;
+
+static double monotonicSeconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compareDoubles(const void* a, const void* b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : x > y;
+}
+
+static BenchResult* addResult(const char* stage, const Bench* b)
+{
+  BenchResult* r;
+
+  if(resultCount == MAX_RESULTS) {
+    fprintf(stderr, "Too many results, dropping %s\n", stage);
+    return NULL;
+  }
+  r = &results[resultCount++];
+  memset(r, 0, sizeof(BenchResult));
+  snprintf(r->stage, sizeof(r->stage), "%s", stage);
+  if(b != NULL) {
+    r->megapixels = b->megapixels;
+    r->width = b->synth.width;
+    r->height = b->synth.height;
+  }
+  return r;
+}
+
+static void printResult(const BenchResult* r)
+{
+  char size[32] = "";
+
+  if(r->megapixels > 0) snprintf(size, sizeof(size), "%g MP", r->megapixels);
+  if(r->skipped) {
+    printf("%-22s %8s  skipped: %s\n", r->stage, size, r->skipped);
+  } else if(r->bytes > 0) {
+    printf("%-22s %8s  %10.3f ms  %10.1f MB/s\n", r->stage, size, r->median * 1e3, r->bytes / r->median / 1e6);
+  } else if(r->ops > 0) {
+    printf("%-22s %8s  %10.3f ms  %10.2f ns/op\n", r->stage, size, r->median * 1e3, r->median * 1e9 / r->ops);
+  } else {
+    printf("%-22s %8s  %10.3f ms\n", r->stage, size, r->median * 1e3);
+  }
+  fflush(stdout);
+}
+
+static void skipStage(const char* stage, const Bench* b, const char* why)
+{
+  BenchResult* r = addResult(stage, b);
+  if(r == NULL) return;
+  r->skipped = why;
+  printResult(r);
+}
+
+//time run at least repeat times, and quick stages until MIN_STAGE_SECONDS have passed, then record
+//the median. reset undoes a run before the next one, so whatever the last run made is still there
+//afterwards. returns 0 if a run failed
+static int timeStage(const char* stage, Bench* b, double bytes, double ops,
+                     int (*run)(Bench* b), void (*reset)(Bench* b))
+{
+  double times[MAX_RUNS], total = 0;
+  int runs = 0;
+  BenchResult* r;
+
+  while(runs < MAX_RUNS && (runs < b->repeat || total < MIN_STAGE_SECONDS)) {
+    double start;
+    if(runs > 0 && reset != NULL) reset(b);
+    start = monotonicSeconds();
+    if(!run(b)) {
+      skipStage(stage, b, "failed");
+      return 0;
+    }
+    times[runs] = monotonicSeconds() - start;
+    total += times[runs++];
+  }
+  qsort(times, runs, sizeof(double), compareDoubles);
+
+  r = addResult(stage, b);
+  if(r == NULL) return 1;
+  r->runs = runs;
+  r->median = runs % 2 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+  r->best = times[0];
+  r->bytes = bytes;
+  r->ops = ops;
+  printResult(r);
+  return 1;
+}
+
+//whether a stage holding bytes in total at its peak fits in memory without swapping
+static int fits(const Bench* b, double bytes)
+{
+  return bytes <= (double)b->memoryLimit;
+}
+
+static int runParse(Bench* b)
+{
+  PnmHeader hdr;
+  int i, result = PNM_OK;
+
+  for(i = 0; i < PARSE_ITERATIONS && result == PNM_OK; i++)
+    result = pnmParseHeader(b->parseBuffer, b->parseLength, &hdr);
+  return result == PNM_OK;
+}
+
+//the path of one of the files in the header directory, every fourth a graymap
+static void headerFilePath(const Bench* b, int i, char* path, size_t size)
+{
+  snprintf(path, size, "%s/h%04d.%s", b->headerDir, i, i % 4 == 3 ? "pgm" : "ppm");
+}
+
+//small images of varied layouts, made once and kept like the big ones
+static int prepareHeaderFiles(Bench* b, const char* dir)
+{
+  char path[1100];
+  struct stat st;
+  int i;
+
+  snprintf(b->headerDir, sizeof(b->headerDir), "%s/headers", dir);
+  headerFilePath(b, HEADER_FILES - 1, path, sizeof(path));
+  if(stat(path, &st) == 0) return 1;
+  if(mkdir(b->headerDir, 0755) != 0 && errno != EEXIST) {
+    perror("Unable to create the header directory");
+    return 0;
+  }
+  for(i = 0; i < HEADER_FILES; i++) {
+    SynthImage s;
+    FILE* f;
+    int ok;
+
+    memset(&s, 0, sizeof(SynthImage));
+    s.width = 64 + i % 61;
+    s.height = 48 + i % 37;
+    s.format = i % 4 == 3 ? 5 : 6;
+    s.maxval = i % 8 == 5 ? 65535 : 255;
+    s.seed = (uint32_t)i;
+    headerFilePath(b, i, path, sizeof(path));
+    f = fopen(path, "wb");
+    if(f == NULL) {
+      perror("Unable to create a header file");
+      return 0;
+    }
+    ok = synthWrite(&s, f);
+    if(fclose(f) != 0 || !ok) {
+      perror("Unable to write a header file");
+      return 0;
+    }
+  }
+  return 1;
+}
+
+//open every file and read its header, as the thumbnail workers do before seeking to the rows
+static int runReadHeaders(Bench* b)
+{
+  char path[1100];
+  int i;
+
+  for(i = 0; i < HEADER_FILES; i++) {
+    PnmHeader hdr;
+    FILE* f;
+    int result;
+
+    headerFilePath(b, i, path, sizeof(path));
+    f = fopen(path, "rb");
+    if(f == NULL) return 0;
+    result = pnmReadHeader(f, &hdr);
+    fclose(f);
+    if(result != PNM_OK) return 0;
+  }
+  return 1;
+}
+
+static void benchLinmath(Bench* b)
+{
+  static const char* names[2][4] = {
+    {"linmath_mul_scalar", "linmath_mul_vec4_scalar", "linmath_vec4_batch_scalar", "linmath_quat_mul_scalar"},
+    {"linmath_mul_simd", "linmath_mul_vec4_simd", "linmath_vec4_batch_simd", "linmath_quat_mul_simd"}
+  };
+  double ns[2][4][MAX_RUNS];
+  int runs = b->repeat < MAX_RUNS ? b->repeat : MAX_RUNS;
+  int i, k, v;
+
+  for(i = 0; i < runs; i++) {
+    for(v = 0; v < 2; v++) {
+      LinmathTimes t;
+      if(v == 0) linmathBenchScalar(&t, LINMATH_ITERATIONS);
+      else linmathBenchSimd(&t, LINMATH_ITERATIONS);
+      ns[v][0][i] = t.mul;
+      ns[v][1][i] = t.mulVec4;
+      ns[v][2][i] = t.mulVec4Batch;
+      ns[v][3][i] = t.quatMul;
+    }
+  }
+
+  //recorded as the time for all the calls, so they compare like every other stage
+  for(v = 0; v < 2; v++) {
+    for(k = 0; k < 4; k++) {
+      BenchResult* r = addResult(names[v][k], NULL);
+      if(r == NULL) return;
+      qsort(ns[v][k], runs, sizeof(double), compareDoubles);
+      r->runs = runs;
+      r->ops = LINMATH_ITERATIONS;
+      r->median = ns[v][k][runs / 2] * 1e-9 * LINMATH_ITERATIONS;
+      r->best = ns[v][k][0] * 1e-9 * LINMATH_ITERATIONS;
+      printResult(r);
+    }
+  }
+}
+
+//reads the file the way the viewer does, header and all
+static int runLoad(Bench* b)
+{
+  FILE* f = fopen(b->path, "rb");
+  PnmHeader hdr;
+  int ok;
+
+  if(f == NULL) {
+    perror("Unable to open the image");
+    return 0;
+  }
+  ok = pnmReadHeader(f, &hdr) == PNM_OK;
+  if(ok) b->image = malloc(hdr.payloadBytes);
+  ok = ok && b->image != NULL && fread(b->image, 1, hdr.payloadBytes, f) == hdr.payloadBytes;
+  fclose(f);
+  return ok;
+}
+
+static void resetLoad(Bench* b)
+{
+  free(b->image);
+  b->image = NULL;
+}
+
+static int runConvert(Bench* b)
+{
+  const PnmHeader* hdr = &b->convertHeader;
+  size_t outRow = (size_t)hdr->width * 3;
+  unsigned int y;
+
+  for(y = 0; y < hdr->height; y += b->bandRows) {
+    unsigned int rows = hdr->height - y < b->bandRows ? hdr->height - y : b->bandRows;
+    pnmToRgb8(b->converted + y * outRow, b->band, hdr, rows);
+  }
+  return 1;
+}
+
+//expand 8 bit gray and 16 bit RGB, the layouts the viewer has to convert on load
+static void benchConvert(Bench* b, const char* stage, int format, unsigned int maxval)
+{
+  SynthImage s = b->synth;
+  char header[128];
+  size_t rowBytes, headerLength;
+
+  s.format = format;
+  s.maxval = maxval;
+  rowBytes = synthRowBytes(&s);
+  b->bandRows = CONVERT_BAND_BYTES / rowBytes;
+  if(b->bandRows < 1) b->bandRows = 1;
+  if(b->bandRows > s.height) b->bandRows = s.height;
+
+  if(!fits(b, b->imageBytes + (double)rowBytes * b->bandRows)) {
+    skipStage(stage, b, "memory");
+    return;
+  }
+  headerLength = synthHeader(&s, header, sizeof(header));
+  b->band = malloc(rowBytes * b->bandRows);
+  b->converted = malloc(b->imageBytes);
+  if(b->band == NULL || b->converted == NULL ||
+     pnmParseHeader((const unsigned char*)header, headerLength, &b->convertHeader) != PNM_OK) {
+    skipStage(stage, b, "memory");
+  } else {
+    synthRows(&s, b->band, 0, b->bandRows);
+    timeStage(stage, b, b->imageBytes, 0, runConvert, NULL);
+  }
+  free(b->band);
+  free(b->converted);
+  b->band = b->converted = NULL;
+}
+
+static int runMipmap(Bench* b)
+{
+  return buildMipChain(&b->chain, b->image, b->synth.width, b->synth.height);
+}
+
+static void resetMipmap(Bench* b)
+{
+  freeMipChain(&b->chain);
+}
+
+//per channel histogram, range and mean: one read of every pixel with a little work on each, the
+//floor for any pass over the whole image
+static int runStats(Bench* b)
+{
+  static size_t histogram[3][256];
+  const unsigned char* p = b->image;
+  const unsigned char* end = p + b->imageBytes;
+  double mean[3] = {0, 0, 0};
+  int k, v, low[3], high[3];
+
+  memset(histogram, 0, sizeof(histogram));
+  for(; p < end; p += 3) {
+    histogram[0][p[0]]++;
+    histogram[1][p[1]]++;
+    histogram[2][p[2]]++;
+  }
+  for(k = 0; k < 3; k++) {
+    low[k] = 255;
+    high[k] = 0;
+    for(v = 0; v < 256; v++) {
+      if(!histogram[k][v]) continue;
+      if(v < low[k]) low[k] = v;
+      high[k] = v;
+      mean[k] += (double)v * histogram[k][v];
+    }
+    mean[k] /= (double)b->synth.width * b->synth.height;
+  }
+  //the generator never makes an empty channel, anything else means the pass went wrong
+  return high[0] >= low[0] && high[1] >= low[1] && high[2] >= low[2] && mean[0] > 0;
+}
+
+static int runSoftPrepare(Bench* b)
+{
+  return softImageInit(&b->soft, &b->chain);
+}
+
+static void resetSoftPrepare(Bench* b)
+{
+  softImageFree(&b->soft);
+}
+
+static int runSoftRender(Bench* b)
+{
+  softRender(b->renderer, &b->fb, &b->soft, b->mvp, 1);
+  return 1;
+}
+
+static int runFilter(Bench* b)
+{
+  return filterImage(b->filtered, b->image, b->synth.width, b->synth.height, &b->filters, b->renderer);
+}
+
+//the whole image fitted to the frame, then a quarter size and sheared, which reads the smaller mip
+//levels and, on the GPU, samples anisotropically
+static void setView(Bench* b, float scale, float shear)
+{
+  mat4x4 sh, zoom;
+
+  mat4x4_identity(sh);
+  sh[1][0] = shear;
+  mat4x4_identity(zoom);
+  zoom[0][0] = zoom[1][1] = scale;
+  mat4x4_mul(b->mvp, zoom, sh);
+  b->scale = scale;
+  b->shear = shear;
+}
+
+static int startGl(Bench* b)
+{
+  if(!offscreenStart()) return 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &b->maxTexture);
+  if(!glHasExtension("GL_ARB_framebuffer_object")) {
+    fprintf(stderr, "Unable to render offscreen: no framebuffer objects\n");
+    offscreenStop();
+    return 0;
+  }
+  createImageProgram(&b->prog);
+  createImageQuad(&b->vertexBuffer, &b->EBO);
+
+  //there is no window, frames are drawn into a renderbuffer the size of one
+  glGenFramebuffers(1, &b->fbo);
+  glGenRenderbuffers(1, &b->colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, b->colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, FRAME_WIDTH, FRAME_HEIGHT);
+  glBindFramebuffer(GL_FRAMEBUFFER, b->fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, b->colorBuffer);
+  if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "Unable to render offscreen: can't draw into a %dx%d renderbuffer\n", FRAME_WIDTH, FRAME_HEIGHT);
+    offscreenStop();
+    return 0;
+  }
+  b->hasGlFilter = glFilterInit(&b->glFilter);
+  return 1;
+}
+
+static void stopGl(Bench* b)
+{
+  if(b->hasGlFilter) glFilterFree(&b->glFilter);
+  glDeleteFramebuffers(1, &b->fbo);
+  glDeleteRenderbuffers(1, &b->colorBuffer);
+  glDeleteBuffers(1, &b->vertexBuffer);
+  glDeleteBuffers(1, &b->EBO);
+  glDeleteProgram(b->prog.program);
+  offscreenStop();
+}
+
+//same texture setup as the viewer, and glFinish so the time includes the driver's copy
+static int runGlUpload(Bench* b)
+{
+  glGenTextures(1, &b->texture);
+  glBindTexture(GL_TEXTURE_2D, b->texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  uploadMipChain(&b->chain);
+  glFinish();
+  return glGetError() == GL_NO_ERROR;
+}
+
+static void resetGlUpload(Bench* b)
+{
+  glDeleteTextures(1, &b->texture);
+  b->texture = 0;
+}
+
+static int runGlDraw(Bench* b)
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, b->fbo);
+  glViewport(0, 0, FRAME_WIDTH, FRAME_HEIGHT);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glBindTexture(GL_TEXTURE_2D, b->texture);
+  if(b->mipmapped) {
+    samplingUpdate(&b->sampling, samplingFootprint(b->synth.width, b->synth.height, FRAME_WIDTH, FRAME_HEIGHT,
+                                                   b->scale), b->shear);
+  }
+  glUseProgram(b->prog.program);
+  bindVertexLayout(&b->prog);
+  glUniform1i(b->prog.tex_location, 0);
+  glUniformMatrix4fv(b->prog.mvp_location, 1, GL_FALSE, (const GLfloat*)b->mvp);
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+  glFinish();
+  return 1;
+}
+
+static int runGlFilter(Bench* b)
+{
+  int ok = glFilterRun(&b->glFilter, &b->filters, b->texture, b->synth.width, b->synth.height, 1.0f);
+  glFinish();
+  return ok;
+}
+
+static void skipGl(Bench* b, const char* why)
+{
+  static const char* stages[] = {
+    "gl_upload", "gl_draw", "gl_draw_zoomed", "gl_draw_zoomed_nomip", "gl_filter_blur4"
+  };
+  int i;
+
+  for(i = 0; i < (int)(sizeof(stages) / sizeof(stages[0])); i++)
+    skipStage(stages[i], b, why);
+}
+
+static void benchGl(Bench* b, double mipBytes)
+{
+  double frame = (double)FRAME_WIDTH * FRAME_HEIGHT;
+  //llvmpipe keeps textures in system memory, as RGBA
+  double textureBytes = mipBytes * 4 / 3;
+
+  if(!b->gl) {
+    skipGl(b, "no GL");
+    return;
+  }
+  if((GLint)b->synth.width > b->maxTexture || (GLint)b->synth.height > b->maxTexture) {
+    skipGl(b, "texture too large");
+    return;
+  }
+  if(!fits(b, mipBytes + textureBytes)) {
+    skipGl(b, "memory");
+    return;
+  }
+
+  if(!timeStage("gl_upload", b, mipBytes, 0, runGlUpload, resetGlUpload)) {
+    resetGlUpload(b);
+    return;
+  }
+  samplingInit(&b->sampling);
+  b->mipmapped = 1;
+  setView(b, 1.0f, 0.0f);
+  timeStage("gl_draw", b, 0, frame, runGlDraw, NULL);
+  setView(b, 0.25f, 0.5f);
+  timeStage("gl_draw_zoomed", b, 0, frame, runGlDraw, NULL);
+
+  //the same view reading level 0 alone, what every zoomed out frame cost before the mip chain
+  glBindTexture(GL_TEXTURE_2D, b->texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  b->mipmapped = 0;
+  timeStage("gl_draw_zoomed_nomip", b, 0, frame, runGlDraw, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, b->chain.levels - 1);
+  samplingInit(&b->sampling);
+  b->mipmapped = 1;
+
+  //a 16 bit texture and an 8 bit output with mipmaps on top of the image
+  if(!b->hasGlFilter)
+    skipStage("gl_filter_blur4", b, "no framebuffer objects");
+  else if(!fits(b, mipBytes + textureBytes + (double)b->synth.width * b->synth.height * (8 + 16.0 / 3)))
+    skipStage("gl_filter_blur4", b, "memory");
+  else
+    timeStage("gl_filter_blur4", b, b->imageBytes, 0, runGlFilter, NULL);
+
+  //drop this size's textures before the next one
+  if(b->hasGlFilter) {
+    glFilterFree(&b->glFilter);
+    b->hasGlFilter = glFilterInit(&b->glFilter);
+  }
+  resetGlUpload(b);
+}
+
+//make the image file unless one from an earlier run is already there
+static int prepareImage(Bench* b, const char* dir)
+{
+  char header[128];
+  size_t expected = synthHeader(&b->synth, header, sizeof(header)) + synthRowBytes(&b->synth) * b->synth.height;
+  struct stat st;
+  FILE* f;
+  double start;
+  int ok;
+
+  snprintf(b->path, sizeof(b->path), "%s/synth-%gmp.ppm", dir, b->megapixels);
+  if(stat(b->path, &st) == 0 && (size_t)st.st_size == expected) return 1;
+
+  fprintf(stderr, "Generating %s, %ux%u\n", b->path, b->synth.width, b->synth.height);
+  start = monotonicSeconds();
+  f = fopen(b->path, "wb");
+  if(f == NULL) {
+    perror("Unable to create the image");
+    return 0;
+  }
+  ok = synthWrite(&b->synth, f);
+  ok = fclose(f) == 0 && ok;
+  if(!ok) {
+    perror("Unable to write the image");
+    remove(b->path);
+    return 0;
+  }
+  fprintf(stderr, "Generated in %.1f s\n", monotonicSeconds() - start);
+  return 1;
+}
+
+static void benchSize(Bench* b, double megapixels, const char* dir)
+{
+  double frame = (double)FRAME_WIDTH * FRAME_HEIGHT;
+  double image, mipBytes, softBytes;
+  int level;
+
+  b->megapixels = megapixels;
+  memset(&b->synth, 0, sizeof(SynthImage));
+  synthSize(megapixels, &b->synth.width, &b->synth.height);
+  b->synth.format = 6;
+  b->synth.maxval = 255;
+  b->synth.seed = 1;
+  b->imageBytes = (size_t)b->synth.width * b->synth.height * 3;
+  image = (double)b->imageBytes;
+  mipBytes = image * 4 / 3;
+  softBytes = mipBytes * 4 / 3;
+
+  if(!prepareImage(b, dir)) {
+    skipStage("load", b, "no image file");
+    return;
+  }
+
+  benchConvert(b, "convert_p5", 5, 255);
+  benchConvert(b, "convert_p6_16bit", 6, 65535);
+
+  if(!fits(b, image)) {
+    skipStage("load", b, "memory");
+    return;
+  }
+  if(!timeStage("load", b, image, 0, runLoad, resetLoad)) {
+    resetLoad(b);
+    return;
+  }
+
+  if(!fits(b, mipBytes)) {
+    skipStage("mipmap", b, "memory");
+    resetLoad(b);
+    return;
+  }
+  if(!timeStage("mipmap", b, image, 0, runMipmap, resetMipmap)) {
+    resetLoad(b);
+    return;
+  }
+  timeStage("stats", b, image, 0, runStats, NULL);
+
+  if(!fits(b, mipBytes + softBytes)) {
+    skipStage("soft_prepare", b, "memory");
+    skipStage("soft_render", b, "memory");
+    skipStage("soft_render_zoomed", b, "memory");
+  } else if(timeStage("soft_prepare", b, image, 0, runSoftPrepare, resetSoftPrepare)) {
+    setView(b, 1.0f, 0.0f);
+    timeStage("soft_render", b, 0, frame, runSoftRender, NULL);
+    setView(b, 0.25f, 0.5f);
+    timeStage("soft_render_zoomed", b, 0, frame, runSoftRender, NULL);
+    softImageFree(&b->soft);
+  }
+
+  if(!fits(b, mipBytes + image)) {
+    skipStage("filter_blur4", b, "memory");
+  } else if((b->filtered = malloc(b->imageBytes)) == NULL) {
+    skipStage("filter_blur4", b, "memory");
+  } else {
+    timeStage("filter_blur4", b, image, 0, runFilter, NULL);
+    free(b->filtered);
+    b->filtered = NULL;
+  }
+
+  //the chain's own bytes, level 0 is the image
+  mipBytes = 0;
+  for(level = 0; level < b->chain.levels; level++)
+    mipBytes += (double)b->chain.width[level] * b->chain.height[level] * 3;
+  benchGl(b, mipBytes);
+
+  freeMipChain(&b->chain);
+  resetLoad(b);
+}
+
+static void writeString(FILE* f, const char* s)
+{
+  fputc('"', f);
+  for(; *s; s++) {
+    if(*s == '"' || *s == '\\') fputc('\\', f);
+    if((unsigned char)*s >= 0x20) fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+static int writeResults(const char* path, const Bench* b, int threads)
+{
+  FILE* f = fopen(path, "w");
+  int i;
+
+  if(f == NULL) {
+    perror("Unable to write the results");
+    return 0;
+  }
+  fprintf(f, "{\n  \"version\": 1,\n  \"cpus\": %ld,\n  \"threads\": %d,\n  \"repeat\": %d,\n  \"renderer\": ",
+          sysconf(_SC_NPROCESSORS_ONLN), threads, b->repeat);
+  writeString(f, b->gl ? offscreenRenderer() : "none");
+  fprintf(f, ",\n  \"results\": [\n");
+  for(i = 0; i < resultCount; i++) {
+    const BenchResult* r = &results[i];
+    fprintf(f, "    {\"stage\": \"%s\", \"megapixels\": %g", r->stage, r->megapixels);
+    if(r->width) fprintf(f, ", \"width\": %u, \"height\": %u", r->width, r->height);
+    if(r->skipped) {
+      fprintf(f, ", \"skipped\": \"%s\"", r->skipped);
+    } else {
+      fprintf(f, ", \"runs\": %d, \"median_s\": %.6g, \"best_s\": %.6g", r->runs, r->median, r->best);
+      if(r->bytes > 0) fprintf(f, ", \"mb_per_s\": %.6g", r->bytes / r->median / 1e6);
+      if(r->ops > 0) fprintf(f, ", \"ns_per_op\": %.6g", r->median * 1e9 / r->ops);
+    }
+    fprintf(f, "}%s\n", i + 1 < resultCount ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  if(fclose(f) != 0) {
+    perror("Unable to write the results");
+    return 0;
+  }
+  return 1;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "Usage: ./ezview-bench [--sizes 1,16,64] [--repeat n] [--threads n] [--dir data] "
+                  "[--out results.json] [--no-gl]\n");
+}
+
+int main(int argc, char *argv[])
+{
+  static Bench b;
+  double sizes[MAX_SIZES];
+  int sizeCount = 0, threads = 0, useGl = 1, workers, ok, i;
+  const char *sizeList = "1,16,64", *dir = "bench/data", *out = "bench/results.json";
+  PnmHeader hdr;
+  SynthImage s;
+  char* end;
+
+  b.repeat = 3;
+  for(i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+      sizeList = argv[++i];
+    } else if(strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      b.repeat = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+      dir = argv[++i];
+    } else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      out = argv[++i];
+    } else if(strcmp(argv[i], "--no-gl") == 0) {
+      useGl = 0;
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if(b.repeat < 1) b.repeat = 1;
+
+  //megapixels, e.g. 1,16,64 or 0.5,1024
+  for(end = (char*)sizeList; *end && sizeCount < MAX_SIZES; ) {
+    double mp = strtod(end, &end);
+    if(mp <= 0 || (*end != ',' && *end != '\0')) {
+      fprintf(stderr, "Bad size list %s, expected megapixels like 1,16,64\n", sizeList);
+      return 1;
+    }
+    sizes[sizeCount++] = mp;
+    if(*end == ',') end++;
+  }
+  if(mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    perror("Unable to create the image directory");
+    return 1;
+  }
+
+  //leave a quarter of memory for the system, a stage that would need more is skipped
+  b.memoryLimit = (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGESIZE) / 4 * 3;
+  b.renderer = softRendererStart(threads);
+  if(b.renderer == NULL) {
+    fprintf(stderr, "Unable to start the render threads\n");
+    return 1;
+  }
+  if(!framebufferResize(&b.fb, FRAME_WIDTH, FRAME_HEIGHT)) {
+    perror("Unable to allocate the frame");
+    return 1;
+  }
+  filterParse(&b.filters, "blur:4");
+  b.gl = useGl && startGl(&b);
+  //the calling thread draws tiles too
+  workers = b.renderer->workerCount + 1;
+  printf("%d threads, GL renderer: %s\n", workers, b.gl ? offscreenRenderer() : "none");
+
+  //a header with a comment, as most tools write them
+  memset(&s, 0, sizeof(SynthImage));
+  s.width = 4000;
+  s.height = 3000;
+  s.format = 6;
+  s.maxval = 255;
+  b.parseLength = synthHeader(&s, (char*)b.parseBuffer, sizeof(b.parseBuffer));
+  if(pnmParseHeader(b.parseBuffer, b.parseLength, &hdr) != PNM_OK) {
+    fprintf(stderr, "Unable to parse the generated header\n");
+    return 1;
+  }
+  timeStage("parse_header", &b, (double)b.parseLength * PARSE_ITERATIONS, PARSE_ITERATIONS, runParse, NULL);
+  if(prepareHeaderFiles(&b, dir))
+    timeStage("read_headers", &b, 0, HEADER_FILES, runReadHeaders, NULL);
+  else
+    skipStage("read_headers", &b, "no header files");
+  benchLinmath(&b);
+
+  for(i = 0; i < sizeCount; i++)
+    benchSize(&b, sizes[i], dir);
+
+  //the renderer string is needed for the results, so GL stops after they are written
+  ok = writeResults(out, &b, workers);
+  if(b.gl) stopGl(&b);
+  framebufferFree(&b.fb);
+  softRendererStop(b.renderer);
+  if(!ok) return 1;
+  printf("Results written to %s\n", out);
+  return 0;
+}
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+# Compares two runs of ezview-bench and fails if any stage got slower than the threshold allows.
+#
+# Usage: ./compare.py baseline.json results.json [--threshold percent] [--min-ms ms]
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    return data, {(r["stage"], r["megapixels"]): r for r in data["results"]}
+
+
+def size(megapixels):
+    return "%g MP" % megapixels if megapixels else ""
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flag stages of ezview-bench that got slower.")
+    parser.add_argument("baseline")
+    parser.add_argument("results")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percent a stage may slow down before it counts as a regression (default 10)")
+    parser.add_argument("--min-ms", type=float, default=1.0,
+                        help="ignore stages faster than this in both runs, they are mostly noise (default 1)")
+    args = parser.parse_args()
+
+    base, baseResults = load(args.baseline)
+    new, newResults = load(args.results)
+
+    # numbers from another machine or renderer say nothing about the code
+    for key in ("cpus", "threads", "renderer"):
+        if base.get(key) != new.get(key):
+            print("warning: %s differs, %s in the baseline and %s now" % (key, base.get(key), new.get(key)))
+
+    regressions = 0
+    print("%-26s %8s %12s %12s %8s" % ("stage", "size", "baseline ms", "now ms", "change"))
+    for key, now in newResults.items():
+        was = baseResults.get(key)
+        stage, megapixels = key
+        if was is None:
+            print("%-26s %8s %12s %12s %8s" % (stage, size(megapixels), "-", "new", ""))
+            continue
+        if "skipped" in now or "skipped" in was:
+            if "skipped" in now and "skipped" not in was:
+                print("%-26s %8s %12.3f %12s %8s  REGRESSION" % (stage, size(megapixels), was["median_s"] * 1e3,
+                                                                "skipped", ""))
+                regressions += 1
+            continue
+
+        before, after = was["median_s"] * 1e3, now["median_s"] * 1e3
+        change = (after - before) / before * 100 if before > 0 else 0
+        flag = ""
+        if change > args.threshold and max(before, after) >= args.min_ms:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold and max(before, after) >= args.min_ms:
+            flag = "  faster"
+        print("%-26s %8s %12.3f %12.3f %+7.1f%%%s" % (stage, size(megapixels), before, after, change, flag))
+
+    for key in baseResults:
+        if key not in newResults:
+            print("%-26s %8s  missing from this run" % (key[0], size(key[1])))
+
+    if regressions:
+        print("%d stage%s slower than the baseline by more than %g%%" %
+              (regressions, "" if regressions == 1 else "s", args.threshold))
+        return 1
+    print("No regressions beyond %g%%" % args.threshold)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,73 @@
+//built once as linmathBenchScalar and once as linmathBenchSimd, see the makefile
+#include "linbench.h"
+#include "../linmath.h"
+
+#include <time.h>
+
+#ifndef LINBENCH_NAME
+#error define LINBENCH_NAME to the function this copy should be built as
+#endif
+
+#define BATCH_POINTS 1024
+
+//stops the compiler from dropping loops whose results are otherwise unused
+static volatile float linbenchSink;
+
+static double seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void LINBENCH_NAME(LinmathTimes* t, long iterations)
+{
+  static vec4 in[BATCH_POINTS], out[BATCH_POINTS];
+  mat4x4 M, R, S;
+  vec4 v = {1, 0.5f, 0.25f, 1}, w;
+  quat p = {0, 0, 0, 1}, q = {sinf(0.05f), 0, 0, cosf(0.05f)}, r;
+  double start;
+  long i, passes = iterations / BATCH_POINTS * 16 + 1;
+
+  //each result feeds the next call, a rotation keeps the values from growing
+  mat4x4_identity(M);
+  mat4x4_identity(S);
+  mat4x4_rotate_Z(R, S, 0.1f);
+  start = seconds();
+  for(i = 0; i < iterations; i++) {
+    mat4x4_mul(S, M, R);
+    mat4x4_mul(M, S, R);
+  }
+  t->mul = (seconds() - start) * 1e9 / (2.0 * iterations);
+  linbenchSink = M[0][0];
+
+  start = seconds();
+  for(i = 0; i < iterations; i++) {
+    mat4x4_mul_vec4(w, R, v);
+    mat4x4_mul_vec4(v, R, w);
+  }
+  t->mulVec4 = (seconds() - start) * 1e9 / (2.0 * iterations);
+  linbenchSink = v[0];
+
+  for(i = 0; i < BATCH_POINTS; i++) {
+    in[i][0] = (float)i;
+    in[i][1] = (float)(BATCH_POINTS - i);
+    in[i][2] = 0;
+    in[i][3] = 1;
+  }
+  start = seconds();
+  for(i = 0; i < passes; i++) {
+    mat4x4_mul_vec4_batch(out, R, in, BATCH_POINTS);
+    in[i % BATCH_POINTS][0] = out[BATCH_POINTS - 1][0];
+  }
+  t->mulVec4Batch = (seconds() - start) * 1e9 / ((double)passes * BATCH_POINTS);
+  linbenchSink = out[0][0];
+
+  start = seconds();
+  for(i = 0; i < iterations; i++) {
+    quat_mul(r, p, q);
+    quat_mul(p, r, q);
+  }
+  t->quatMul = (seconds() - start) * 1e9 / (2.0 * iterations);
+  linbenchSink = p[0];
+}
@@ -0,0 +1,16 @@
+#ifndef LINBENCH_H
+#define LINBENCH_H
+
+//nanoseconds per call of the linmath routines that have vector versions
+typedef struct {
+  double mul;           //mat4x4_mul
+  double mulVec4;       //mat4x4_mul_vec4
+  double mulVec4Batch;  //mat4x4_mul_vec4_batch, per point
+  double quatMul;       //quat_mul
+} LinmathTimes;
+
+// linbench.c is built twice, with and without LINMATH_SIMD, to give these two
+void linmathBenchScalar(LinmathTimes* t, long iterations);
+void linmathBenchSimd(LinmathTimes* t, long iterations);
+
+#endif
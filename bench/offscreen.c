@@ -0,0 +1,74 @@
+#include "offscreen.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+
+//the rest of ezview asks GLFW for these, the benchmarks have no GLFW
+int glHasExtension(const char* name)
+{
+  const char* list = (const char*)glGetString(GL_EXTENSIONS);
+  size_t length = strlen(name);
+
+  //whole names only, GL_ARB_foo must not match GL_ARB_foo_bar
+  while(list != NULL && (list = strstr(list, name)) != NULL) {
+    if(list[length] == ' ' || list[length] == '\0') return 1;
+    list += length;
+  }
+  return 0;
+}
+
+void* glProcAddress(const char* name)
+{
+  return (void*)eglGetProcAddress(name);
+}
+
+int offscreenStart(void)
+{
+  //legacy 2.x like the viewer asks GLFW for, compatibility profile so the shaders build as they are
+  EGLint attribs[] = {EGL_CONTEXT_MAJOR_VERSION, 2, EGL_CONTEXT_MINOR_VERSION, 1, EGL_NONE};
+
+  //pin the software rasterizer so results compare between machines, unless told otherwise
+  setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+
+  display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  if(display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+    fprintf(stderr, "Unable to start EGL: no surfaceless display\n");
+    display = EGL_NO_DISPLAY;
+    return 0;
+  }
+  if(!eglBindAPI(EGL_OPENGL_API)) {
+    fprintf(stderr, "Unable to start EGL: desktop GL is not supported\n");
+    offscreenStop();
+    return 0;
+  }
+  context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+  if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    fprintf(stderr, "Unable to create a GL context: EGL error 0x%x\n", eglGetError());
+    offscreenStop();
+    return 0;
+  }
+  return 1;
+}
+
+void offscreenStop(void)
+{
+  if(display == EGL_NO_DISPLAY) return;
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if(context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+  eglTerminate(display);
+  display = EGL_NO_DISPLAY;
+  context = EGL_NO_CONTEXT;
+}
+
+const char* offscreenRenderer(void)
+{
+  const char* name = context != EGL_NO_CONTEXT ? (const char*)glGetString(GL_RENDERER) : NULL;
+  return name ? name : "none";
+}
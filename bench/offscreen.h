@@ -0,0 +1,13 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include "../glcompat.h"
+
+// make a GL context current with no window or display, through EGL's surfaceless platform. Mesa's
+// software rasterizer is used unless LIBGL_ALWAYS_SOFTWARE is already set. returns 0 if there is none
+int offscreenStart(void);
+void offscreenStop(void);
+// the renderer string, e.g. "llvmpipe (LLVM 15.0.7, 256 bits)"
+const char* offscreenRenderer(void);
+
+#endif
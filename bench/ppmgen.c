@@ -0,0 +1,73 @@
+// Writes the synthetic images the benchmarks use, for trying the viewer on large files.
+// The same arguments always give the same bytes.
+//
+// Usage: ./ppmgen [--gray] [--16bit] [--seed n] megapixels|WIDTHxHEIGHT out.ppm|-
+
+#include "synth.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static void usage(void)
+{
+  fprintf(stderr, "Usage: ./ppmgen [--gray] [--16bit] [--seed n] megapixels|WIDTHxHEIGHT out.ppm|-\n");
+}
+
+int main(int argc, char *argv[])
+{
+  SynthImage s;
+  const char* out;
+  FILE* f;
+  int i, ok;
+
+  memset(&s, 0, sizeof(SynthImage));
+  s.format = 6;
+  s.maxval = 255;
+  s.seed = 1;
+
+  for(i = 1; i < argc && argv[i][0] == '-' && argv[i][1] == '-'; i++) {
+    if(strcmp(argv[i], "--gray") == 0) {
+      s.format = 5;
+    } else if(strcmp(argv[i], "--16bit") == 0) {
+      s.maxval = 65535;
+    } else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      s.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if(argc - i != 2) {
+    usage();
+    return 1;
+  }
+
+  if(sscanf(argv[i], "%ux%u", &s.width, &s.height) != 2) {
+    double megapixels = atof(argv[i]);
+    if(megapixels <= 0) {
+      usage();
+      return 1;
+    }
+    synthSize(megapixels, &s.width, &s.height);
+  }
+  if(s.width == 0 || s.height == 0) {
+    usage();
+    return 1;
+  }
+
+  out = argv[i + 1];
+  f = strcmp(out, "-") == 0 ? stdout : fopen(out, "wb");
+  if(f == NULL) {
+    perror("Unable to create the image");
+    return 1;
+  }
+  ok = synthWrite(&s, f);
+  if(f != stdout) ok = fclose(f) == 0 && ok;
+  else ok = fflush(f) == 0 && ok;
+  if(!ok) {
+    perror("Unable to write the image");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include "synth.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+//rows generated at a time by synthWrite
+#define SYNTH_BAND 64
+
+void synthSize(double megapixels, unsigned int* width, unsigned int* height)
+{
+  double pixels = megapixels * 1e6;
+
+  *width = (unsigned int)(sqrt(pixels * 4 / 3) + 0.5);
+  if(*width < 1) *width = 1;
+  *height = (unsigned int)(pixels / *width + 0.5);
+  if(*height < 1) *height = 1;
+}
+
+size_t synthHeader(const SynthImage* s, char* buf, size_t size)
+{
+  //the comment makes the parser skip something, as it has to for files from most tools
+  int n = snprintf(buf, size, "P%d\n# ezview synthetic image, seed %u\n%u %u\n%u\n",
+                   s->format, (unsigned int)s->seed, s->width, s->height, s->maxval);
+  return n < 0 ? 0 : (size_t)n;
+}
+
+size_t synthRowBytes(const SynthImage* s)
+{
+  return (size_t)s->width * (s->format == 6 ? 3 : 1) * (s->maxval > 255 ? 2 : 1);
+}
+
+//a few bits of noise per pixel, so neither compression in the page cache nor a lucky branch
+//predictor makes the image cheaper than a photo would be
+static inline uint32_t noise(uint32_t x, uint32_t y, uint32_t seed)
+{
+  uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u ^ seed;
+  h ^= h >> 15;
+  h *= 0x2C1B3C6Du;
+  h ^= h >> 12;
+  return h;
+}
+
+//gradients across and down, diagonal bands with hard edges, and noise on top. 8 bit values,
+//widened below for deeper files
+static inline void pixel(const SynthImage* s, uint32_t x, uint32_t y, unsigned int rgb[3])
+{
+  uint32_t n = noise(x, y, s->seed);
+  unsigned int band = ((x + y) >> 6) & 1 ? 170 : 50;
+
+  rgb[0] = (unsigned int)((uint64_t)x * 223 / s->width) + (n & 31);
+  rgb[1] = (unsigned int)((uint64_t)y * 223 / s->height) + ((n >> 5) & 31);
+  rgb[2] = band + ((n >> 10) & 63);
+}
+
+void synthRows(const SynthImage* s, unsigned char* dst, unsigned int y, unsigned int rows)
+{
+  int wide = s->maxval > 255;
+  unsigned int x, end = y + rows;
+
+  for(; y < end; y++) {
+    for(x = 0; x < s->width; x++) {
+      unsigned int rgb[3], k, count = 3;
+
+      pixel(s, x, y, rgb);
+      if(s->format == 5) {
+        rgb[0] = (rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29) >> 8;
+        count = 1;
+      }
+      for(k = 0; k < count; k++) {
+        if(wide) {
+          //the low byte gets its own noise, so it isn't just a copy of the high one
+          unsigned int v = (rgb[k] * s->maxval + (noise(y, x, s->seed + k) & 0xff)) / 255;
+          if(v > s->maxval) v = s->maxval;
+          *dst++ = (unsigned char)(v >> 8);
+          *dst++ = (unsigned char)v;
+        } else {
+          *dst++ = (unsigned char)(rgb[k] * s->maxval / 255);
+        }
+      }
+    }
+  }
+}
+
+int synthWrite(const SynthImage* s, FILE* f)
+{
+  char header[128];
+  size_t headerLength = synthHeader(s, header, sizeof(header));
+  size_t rowBytes = synthRowBytes(s);
+  unsigned char* band;
+  unsigned int y;
+
+  band = malloc(rowBytes * SYNTH_BAND);
+  if(band == NULL) return 0;
+  if(fwrite(header, 1, headerLength, f) != headerLength) {
+    free(band);
+    return 0;
+  }
+  for(y = 0; y < s->height; y += SYNTH_BAND) {
+    unsigned int rows = s->height - y < SYNTH_BAND ? s->height - y : SYNTH_BAND;
+    synthRows(s, band, y, rows);
+    if(fwrite(band, 1, rowBytes * rows, f) != rowBytes * rows) {
+      free(band);
+      return 0;
+    }
+  }
+  free(band);
+  return 1;
+}
@@ -0,0 +1,29 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//a generated test image. the pixels depend only on these fields, so the same image can be made again
+//anywhere, and any band of rows can be made without the ones before it
+typedef struct {
+  unsigned int width;
+  unsigned int height;
+  int format;             //5 for a graymap, 6 for a pixmap
+  unsigned int maxval;    //255 for 8 bit, up to 65535 for 16 bit
+  uint32_t seed;
+} SynthImage;
+
+// width and height with a 4:3 aspect for about megapixels million pixels
+void synthSize(double megapixels, unsigned int* width, unsigned int* height);
+// write the header for the image into buf, returns its length
+size_t synthHeader(const SynthImage* s, char* buf, size_t size);
+// bytes in one row of the file
+size_t synthRowBytes(const SynthImage* s);
+// rows y to y + rows - 1, laid out as they are in the file
+void synthRows(const SynthImage* s, unsigned char* dst, unsigned int y, unsigned int rows);
+// write the whole file. returns 0 if a write failed
+int synthWrite(const SynthImage* s, FILE* f);
+
+#endif
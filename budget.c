@@ -0,0 +1,215 @@
+#include "budget.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MB (1024.0 * 1024.0)
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+//tracked blocks, most recently used at the head
+static MemBlock* head;
+static MemBlock* tail;
+static size_t used[MEM_POOLS];
+static size_t peak[MEM_POOLS];
+static size_t budget[MEM_POOLS];
+static unsigned long useClock;
+static unsigned long enforcePass;
+static const char* poolNames[MEM_POOLS] = {"cpu", "gpu"};
+
+static void detach(MemBlock* b)
+{
+  if(b->prev) b->prev->next = b->next;
+  else head = b->next;
+  if(b->next) b->next->prev = b->prev;
+  else tail = b->prev;
+  b->prev = b->next = NULL;
+}
+
+static void pushFront(MemBlock* b)
+{
+  b->prev = NULL;
+  b->next = head;
+  if(head) head->prev = b;
+  else tail = b;
+  head = b;
+  b->lastUse = ++useClock;
+}
+
+static void account(int pool, size_t oldBytes, size_t newBytes)
+{
+  used[pool] = used[pool] - oldBytes + newBytes;
+  if(used[pool] > peak[pool]) peak[pool] = used[pool];
+}
+
+void memSetBudget(int pool, size_t bytes)
+{
+  pthread_mutex_lock(&lock);
+  budget[pool] = bytes;
+  pthread_mutex_unlock(&lock);
+}
+
+void memDefaultBudgets(void)
+{
+  long pages = sysconf(_SC_PHYS_PAGES), pageSize = sysconf(_SC_PAGESIZE);
+
+  if(pages > 0 && pageSize > 0)
+    memSetBudget(MEM_CPU, (size_t)pages * (size_t)pageSize / 2);
+  //GL has no portable way to ask how much video memory there is
+  memSetBudget(MEM_GPU, 0);
+}
+
+size_t memBudget(int pool)
+{
+  size_t b;
+  pthread_mutex_lock(&lock);
+  b = budget[pool];
+  pthread_mutex_unlock(&lock);
+  return b;
+}
+
+size_t memUsed(int pool)
+{
+  size_t u;
+  pthread_mutex_lock(&lock);
+  u = used[pool];
+  pthread_mutex_unlock(&lock);
+  return u;
+}
+
+void memTrack(MemBlock* block, int pool, const char* name, size_t bytes, MemEvict evict, void* user)
+{
+  pthread_mutex_lock(&lock);
+  if(block->tracked) {
+    detach(block);
+    account(block->pool, block->bytes, 0);
+  }
+  block->name = name;
+  block->pool = pool;
+  block->bytes = bytes;
+  block->evict = evict;
+  block->user = user;
+  block->tracked = 1;
+  account(pool, 0, bytes);
+  pushFront(block);
+  pthread_mutex_unlock(&lock);
+}
+
+void memUntrack(MemBlock* block)
+{
+  pthread_mutex_lock(&lock);
+  if(block->tracked) {
+    detach(block);
+    account(block->pool, block->bytes, 0);
+    block->bytes = 0;
+    block->tracked = 0;
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void memResize(MemBlock* block, size_t bytes)
+{
+  pthread_mutex_lock(&lock);
+  if(block->tracked) {
+    account(block->pool, block->bytes, bytes);
+    block->bytes = bytes;
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void memTouch(MemBlock* block)
+{
+  pthread_mutex_lock(&lock);
+  if(block->tracked && block != head) {
+    detach(block);
+    pushFront(block);
+  } else if(block->tracked) {
+    block->lastUse = ++useClock;
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+int memEnforce(void)
+{
+  unsigned long start, pass;
+  int evicted = 0;
+
+  pthread_mutex_lock(&lock);
+  //anything used after this point is needed right now, and each block gets at most one try per call
+  start = useClock;
+  pass = ++enforcePass;
+  for(;;) {
+    MemBlock* victim = NULL;
+    MemBlock* b;
+    size_t before;
+    int pool;
+
+    for(pool = 0; pool < MEM_POOLS; pool++) {
+      if(budget[pool] == 0 || used[pool] <= budget[pool]) continue;
+      //oldest first
+      for(b = tail; b != NULL; b = b->prev) {
+        if(b->lastUse > start) break;
+        if(b->pool == pool && b->evict != NULL && b->bytes > 0 && b->triedPass != pass) {
+          victim = b;
+          break;
+        }
+      }
+      if(victim) break;
+    }
+    if(victim == NULL) break;
+
+    //the callback resizes or untracks the block, so it can't be called with the lock held
+    victim->triedPass = pass;
+    before = victim->bytes;
+    pthread_mutex_unlock(&lock);
+    evicted += victim->evict(victim);
+    pthread_mutex_lock(&lock);
+
+    //a block that gave something back goes to the front, so the next call asks the others first.
+    //one that gave nothing keeps its place, its age still says when it was last used
+    if(victim->tracked && victim->bytes < before) {
+      if(victim != head) {
+        detach(victim);
+        pushFront(victim);
+      } else {
+        victim->lastUse = ++useClock;
+      }
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return evicted;
+}
+
+void memDescribe(char* buf, size_t size)
+{
+  size_t n = 0;
+  int pool;
+
+  buf[0] = '\0';
+  pthread_mutex_lock(&lock);
+  for(pool = 0; pool < MEM_POOLS && n < size; pool++) {
+    if(budget[pool])
+      n += snprintf(buf + n, size - n, "%s%s %.0f/%.0f MB", pool ? "  " : "", poolNames[pool],
+                    used[pool] / MB, budget[pool] / MB);
+    else
+      n += snprintf(buf + n, size - n, "%s%s %.0f MB", pool ? "  " : "", poolNames[pool], used[pool] / MB);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+void memDump(FILE* f)
+{
+  MemBlock* b;
+  int pool;
+
+  pthread_mutex_lock(&lock);
+  for(pool = 0; pool < MEM_POOLS; pool++) {
+    fprintf(f, "%s: %.1f MB used, %.1f MB peak, ", poolNames[pool], used[pool] / MB, peak[pool] / MB);
+    if(budget[pool]) fprintf(f, "%.1f MB budget\n", budget[pool] / MB);
+    else fprintf(f, "no budget\n");
+  }
+  for(b = head; b != NULL; b = b->next)
+    fprintf(f, "  %-4s %10.2f MB  %-10s %s\n", poolNames[b->pool], b->bytes / MB,
+            b->evict ? "evictable" : "in use", b->name);
+  pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,57 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+//where a tracked allocation lives
+enum {
+  MEM_CPU = 0,
+  MEM_GPU,
+  MEM_POOLS
+};
+
+typedef struct MemBlock MemBlock;
+
+//give back some or all of what a block holds. it has to memResize or memUntrack the block itself,
+//and returns 0 if nothing could be released right now. the block is looked at again afterwards, so
+//it must not free the memory the block lives in
+typedef int (*MemEvict)(MemBlock* block);
+
+//one tracked allocation, or a group of them, embedded in whatever owns the memory
+struct MemBlock {
+  const char* name;
+  int pool;
+  size_t bytes;
+  MemEvict evict;           //NULL for memory that is in use and can't be dropped
+  void* user;
+  unsigned long lastUse;
+  unsigned long triedPass;  //last memEnforce call that asked it to evict
+  int tracked;
+  MemBlock *prev, *next;
+};
+
+// limit a pool to bytes, 0 for no limit
+void memSetBudget(int pool, size_t bytes);
+// half of physical memory for the CPU pool, no limit for the GPU one
+void memDefaultBudgets(void);
+size_t memBudget(int pool);
+size_t memUsed(int pool);
+
+// start counting a block against its pool. safe from any thread
+void memTrack(MemBlock* block, int pool, const char* name, size_t bytes, MemEvict evict, void* user);
+void memUntrack(MemBlock* block);
+void memResize(MemBlock* block, size_t bytes);
+// mark a block as just used, so it is evicted last
+void memTouch(MemBlock* block);
+
+// evict the least recently used blocks of any pool over budget. evict callbacks run on the calling
+// thread, which for GPU blocks has to be the one with the context, and evictable blocks must only be
+// untracked from that thread. returns the number evicted
+int memEnforce(void);
+// one line of usage for a window title, e.g. "cpu 120/4096 MB  gpu 48 MB"
+void memDescribe(char* buf, size_t size);
+// every tracked block, most recently used first
+void memDump(FILE* f);
+
+#endif
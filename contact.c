@@ -0,0 +1,438 @@
+#include "ezview.h"
+#include "contact.h"
+#include "pnm.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//gap between thumbnails in the grid, in pixels
+#define THUMB_PAD 8
+
+static int comparePaths(const void* a, const void* b)
+{
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+int collectPpmPaths(const char* dir, char*** paths)
+{
+  DIR* d = opendir(dir);
+  struct dirent* entry;
+  char** list = NULL;
+  int count = 0, cap = 0;
+
+  if(d == NULL) return -1;
+
+  while((entry = readdir(d)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    //graymaps load the same way, so they go in the grid too
+    if(len < 4 || (strcmp(entry->d_name + len - 4, ".ppm") != 0 &&
+                   strcmp(entry->d_name + len - 4, ".pgm") != 0)) continue;
+
+    if(count == cap) {
+      char** grown = realloc(list, sizeof(char*) * (cap ? cap * 2 : 64));
+      if(grown == NULL) break;
+      list = grown;
+      cap = cap ? cap * 2 : 64;
+    }
+    list[count] = malloc(strlen(dir) + len + 2);
+    if(list[count] == NULL) break;
+    sprintf(list[count], "%s/%s", dir, entry->d_name);
+    count++;
+  }
+  closedir(d);
+
+  //out of memory part way through, errno says so
+  if(entry != NULL) {
+    freePpmPaths(list, count);
+    return -1;
+  }
+
+  qsort(list, count, sizeof(char*), comparePaths);
+  *paths = list;
+  return count;
+}
+
+void freePpmPaths(char** paths, int count)
+{
+  int i;
+
+  for(i = 0; i < count; i++)
+    free(paths[i]);
+  free(paths);
+}
+
+//average two rows byte by byte, rounding up like the SIMD instructions do
+static void averageRows(unsigned char* dst, const unsigned char* a, const unsigned char* b, int n)
+{
+  int i = 0;
+#if defined(__SSE2__)
+  for(; i + 16 <= n; i += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_avg_epu8(va, vb));
+  }
+#elif defined(__ARM_NEON)
+  for(; i + 16 <= n; i += 16)
+    vst1q_u8(dst + i, vrhaddq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+#endif
+  for(; i < n; i++)
+    dst[i] = (unsigned char)((a[i] + b[i] + 1) >> 1);
+}
+
+//decode a thumbnail straight into its atlas slot, touching only the rows that get sampled
+static int makeThumbnail(ContactSheet* sheet, Thumb* t)
+{
+  FILE* f = fopen(t->path, "rb");
+  PnmHeader hdr;
+  unsigned char *rows, *rgb, *blended, *dst;
+  int w, h, tw, th, tx, ty, ok = 0;
+  long offset, stride;
+
+  if(f == NULL) return 0;
+  if(pnmReadHeader(f, &hdr) != PNM_OK || hdr.width > 0x7FFFFFFF || hdr.height > 0x7FFFFFFF ||
+     hdr.rowBytes > 0x7FFFFFFF / 3) {
+    fclose(f);
+    return 0;
+  }
+  w = (int)hdr.width;
+  h = (int)hdr.height;
+  offset = ftell(f);
+
+  //fit the longer side into the slot and keep the aspect ratio
+  if(w >= h) {
+    tw = w < THUMB_SIZE ? w : THUMB_SIZE;
+    th = (int)((long)h * tw / w);
+  } else {
+    th = h < THUMB_SIZE ? h : THUMB_SIZE;
+    tw = (int)((long)w * th / h);
+  }
+  if(tw < 1) tw = 1;
+  if(th < 1) th = 1;
+
+  stride = (long)hdr.rowBytes;
+  rows = malloc(stride * 2);
+  rgb = malloc((size_t)w * 3 * 2);
+  blended = malloc((size_t)w * 3);
+  dst = sheet->atlases[t->atlas] + ((long)t->y * ATLAS_SIZE + t->x) * 3;
+
+  for(ty = 0; ty < th; ty++) {
+    //rows have a fixed stride, so every row we skip is just a seek
+    long sy = (long)ty * h / th;
+    int pair = (sy + 1 < h && h > th) ? 2 : 1;
+    unsigned char* out = dst + (long)ty * ATLAS_SIZE * 3;
+
+    if(fseek(f, offset + sy * stride, SEEK_SET) != 0 ||
+       fread(rows, stride, pair, f) != (size_t)pair)
+      goto done;
+
+    pnmToRgb8(rgb, rows, &hdr, pair);
+    if(pair == 2) averageRows(blended, rgb, rgb + w * 3, w * 3);
+    else memcpy(blended, rgb, (size_t)w * 3);
+
+    for(tx = 0; tx < tw; tx++) {
+      long sx = (long)tx * w / tw;
+      long sx1 = (sx + 1 < w && w > tw) ? sx + 1 : sx;
+      int k;
+      for(k = 0; k < 3; k++)
+        out[tx * 3 + k] = (unsigned char)((blended[sx * 3 + k] + blended[sx1 * 3 + k] + 1) >> 1);
+    }
+  }
+  ok = 1;
+  t->w = tw;
+  t->h = th;
+
+done:
+  free(rows);
+  free(rgb);
+  free(blended);
+  fclose(f);
+  return ok;
+}
+
+static void* thumbnailWorker(void* arg)
+{
+  ContactSheet* sheet = arg;
+
+  for(;;) {
+    int index = __sync_fetch_and_add(&sheet->next, 1);
+    Thumb* t;
+    if(index >= sheet->count) break;
+
+    t = &sheet->thumbs[index];
+    t->state = makeThumbnail(sheet, t) ? THUMB_READY : THUMB_FAILED;
+
+    pthread_mutex_lock(&sheet->lock);
+    sheet->finished[sheet->finishedCount++] = index;
+    pthread_mutex_unlock(&sheet->lock);
+  }
+  return NULL;
+}
+
+//free the CPU copies of atlases whose thumbnails have all been uploaded
+static int dropUploadedAtlases(MemBlock* block)
+{
+  ContactSheet* sheet = block->user;
+  int i, kept = 0, freed = 0;
+
+  pthread_mutex_lock(&sheet->lock);
+  for(i = 0; i < sheet->atlasCount; i++) {
+    if(sheet->atlases[i] == NULL) continue;
+    if(sheet->pending[i] > 0) {
+      kept++;
+      continue;
+    }
+    free(sheet->atlases[i]);
+    sheet->atlases[i] = NULL;
+    freed++;
+  }
+  memResize(block, (size_t)kept * ATLAS_SIZE * ATLAS_SIZE * 3);
+  pthread_mutex_unlock(&sheet->lock);
+  return freed > 0;
+}
+
+ContactSheet* contactSheetStart(char** paths, int count)
+{
+  ContactSheet* sheet = calloc(1, sizeof(ContactSheet));
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int i;
+
+  sheet->count = count;
+  sheet->thumbs = calloc(count, sizeof(Thumb));
+  sheet->finished = malloc(sizeof(int) * count);
+  pthread_mutex_init(&sheet->lock, NULL);
+
+  sheet->atlasCount = (count + THUMBS_PER_ATLAS - 1) / THUMBS_PER_ATLAS;
+  sheet->atlases = malloc(sizeof(unsigned char*) * sheet->atlasCount);
+  sheet->pending = calloc(sheet->atlasCount, sizeof(int));
+  for(i = 0; i < sheet->atlasCount; i++)
+    sheet->atlases[i] = calloc((size_t)ATLAS_SIZE * ATLAS_SIZE, 3);
+  memTrack(&sheet->block, MEM_CPU, "contact sheet atlases",
+           (size_t)sheet->atlasCount * ATLAS_SIZE * ATLAS_SIZE * 3, dropUploadedAtlases, sheet);
+
+  for(i = 0; i < count; i++) {
+    int slot = i % THUMBS_PER_ATLAS;
+    sheet->thumbs[i].path = paths[i];
+    sheet->thumbs[i].atlas = i / THUMBS_PER_ATLAS;
+    sheet->thumbs[i].x = (slot % THUMBS_PER_ROW) * THUMB_SIZE;
+    sheet->thumbs[i].y = (slot / THUMBS_PER_ROW) * THUMB_SIZE;
+    sheet->thumbs[i].w = THUMB_SIZE;
+    sheet->thumbs[i].h = THUMB_SIZE;
+    sheet->pending[i / THUMBS_PER_ATLAS]++;
+  }
+
+  sheet->workerCount = cpus > 0 ? (int)cpus : 4;
+  if(sheet->workerCount > count) sheet->workerCount = count;
+  sheet->workers = malloc(sizeof(pthread_t) * sheet->workerCount);
+  for(i = 0; i < sheet->workerCount; i++)
+    pthread_create(&sheet->workers[i], NULL, thumbnailWorker, sheet);
+
+  return sheet;
+}
+
+int contactSheetPoll(ContactSheet* sheet, int* ready, int max)
+{
+  int i, n;
+
+  pthread_mutex_lock(&sheet->lock);
+  n = sheet->finishedCount < max ? sheet->finishedCount : max;
+  memcpy(ready, sheet->finished, sizeof(int) * n);
+  for(i = 0; i < n; i++)
+    sheet->pending[sheet->thumbs[ready[i]].atlas]--;
+  memmove(sheet->finished, sheet->finished + n, sizeof(int) * (sheet->finishedCount - n));
+  sheet->finishedCount -= n;
+  pthread_mutex_unlock(&sheet->lock);
+
+  return n;
+}
+
+void contactSheetFree(ContactSheet* sheet)
+{
+  int i;
+
+  //stop handing out new work, then wait for the files already being read
+  __sync_lock_test_and_set(&sheet->next, sheet->count);
+  for(i = 0; i < sheet->workerCount; i++)
+    pthread_join(sheet->workers[i], NULL);
+
+  memUntrack(&sheet->block);
+  for(i = 0; i < sheet->atlasCount; i++)
+    free(sheet->atlases[i]);
+  free(sheet->atlases);
+  free(sheet->pending);
+  free(sheet->workers);
+  free(sheet->finished);
+  free(sheet->thumbs);
+  pthread_mutex_destroy(&sheet->lock);
+  free(sheet);
+}
+
+//write the two triangles for one grid cell, centred in the cell and in grid pixel units
+static void thumbQuad(Vertex* v, Thumb* t, int index, int columns)
+{
+  float cell = THUMB_SIZE + THUMB_PAD;
+  float x0 = (index % columns) * cell + THUMB_PAD + (THUMB_SIZE - t->w) / 2.0f;
+  float y0 = (index / columns) * cell + THUMB_PAD + (THUMB_SIZE - t->h) / 2.0f;
+  float x1 = x0 + t->w, y1 = y0 + t->h;
+  float s0 = t->x / (float)ATLAS_SIZE, t0 = t->y / (float)ATLAS_SIZE;
+  float s1 = (t->x + t->w) / (float)ATLAS_SIZE, t1 = (t->y + t->h) / (float)ATLAS_SIZE;
+  Vertex quad[6] = {
+    {{x0, y0}, {s0, t0}}, {{x1, y0}, {s1, t0}}, {{x1, y1}, {s1, t1}},
+    {{x0, y0}, {s0, t0}}, {{x1, y1}, {s1, t1}}, {{x0, y1}, {s0, t1}}
+  };
+  memcpy(v, quad, sizeof(quad));
+}
+
+//thumbnails that fit across a framebuffer width pixels wide
+static int gridColumns(int width)
+{
+  int columns = (width - THUMB_PAD) / (THUMB_SIZE + THUMB_PAD);
+  return columns < 1 ? 1 : columns;
+}
+
+int runContactSheet(char** paths, int count)
+{
+  GLFWwindow* window;
+  ImageProgram prog;
+  View view;
+  ContactSheet* sheet;
+  GLuint vertex_buffer, *textures;
+  Vertex* vertexes;
+  int* ready;
+  int i, columns, done = 0;
+  int winWidth = 1024, winHeight = 768, fbWidth, fbHeight, showingMemory = 0;
+  MemBlock textureBlock = {0};
+  char title[256], usage[128];
+
+  glfwSetErrorCallback(error_callback);
+  if (!glfwInit())
+    exit(EXIT_FAILURE);
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+
+  window = glfwCreateWindow(winWidth, winHeight, "ezview", NULL, NULL);
+  if (!window)
+  {
+    glfwTerminate();
+    exit(EXIT_FAILURE);
+  }
+  viewInit(&view);
+  attachView(window, &view);
+  glfwMakeContextCurrent(window);
+  glfwSwapInterval(1);
+
+  createImageProgram(&prog);
+  sheet = contactSheetStart(paths, count);
+  ready = malloc(sizeof(int) * count);
+
+  //one quad per thumbnail, grouped by atlas so each atlas is a single draw call. the grid is laid
+  //out in framebuffer pixels and reflowed whenever the width changes
+  glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+  columns = gridColumns(fbWidth);
+  vertexes = malloc(sizeof(Vertex) * 6 * count);
+  for(i = 0; i < count; i++)
+    thumbQuad(vertexes + i * 6, &sheet->thumbs[i], i, columns);
+
+  glGenBuffers(1, &vertex_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * 6 * count, vertexes, GL_DYNAMIC_DRAW);
+  bindVertexLayout(&prog);
+
+  //thumbnails are packed tightly and are not a multiple of 4 bytes wide
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, ATLAS_SIZE);
+
+  textures = malloc(sizeof(GLuint) * sheet->atlasCount);
+  glGenTextures(sheet->atlasCount, textures);
+  for(i = 0; i < sheet->atlasCount; i++) {
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, ATLAS_SIZE, ATLAS_SIZE, 0, GL_RGB,
+                 GL_UNSIGNED_BYTE, sheet->atlases[i]);
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glUniform1i(prog.tex_location, 0);
+  memTrack(&textureBlock, MEM_GPU, "contact sheet textures",
+           (size_t)sheet->atlasCount * ATLAS_SIZE * ATLAS_SIZE * 4, NULL, NULL);
+
+  while (!glfwWindowShouldClose(window))
+  {
+    int width, height, n;
+    mat4x4 m, p, mvp;
+
+    //upload whatever finished since the last frame so the grid fills in progressively
+    n = contactSheetPoll(sheet, ready, count);
+    for(i = 0; i < n; i++) {
+      Thumb* t = &sheet->thumbs[ready[i]];
+      done++;
+      if(t->state != THUMB_READY) continue;
+
+      glBindTexture(GL_TEXTURE_2D, textures[t->atlas]);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, t->x, t->y, t->w, t->h, GL_RGB, GL_UNSIGNED_BYTE,
+                      sheet->atlases[t->atlas] + ((long)t->y * ATLAS_SIZE + t->x) * 3);
+
+      //the decoded size is only known now, so shrink the placeholder quad to fit
+      thumbQuad(vertexes + ready[i] * 6, t, ready[i], columns);
+      glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vertex) * 6 * ready[i], sizeof(Vertex) * 6,
+                      vertexes + ready[i] * 6);
+    }
+    if(n > 0 || showingMemory != view.showMemory) {
+      memDescribe(usage, sizeof(usage));
+      snprintf(title, sizeof(title), "ezview - %d/%d thumbnails%s%s", done, count,
+               view.showMemory ? "  " : "", view.showMemory ? usage : "");
+      glfwSetWindowTitle(window, title);
+      showingMemory = view.showMemory;
+    }
+
+    glfwGetFramebufferSize(window, &width, &height);
+    if(width > 0 && height > 0 && gridColumns(width) != columns) {
+      columns = gridColumns(width);
+      for(i = 0; i < count; i++)
+        thumbQuad(vertexes + i * 6, &sheet->thumbs[i], i, columns);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(Vertex) * 6 * count, vertexes);
+    }
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    //map grid pixels onto the window one to one, then apply the usual view transform on top
+    viewTransform(&view, m);
+    mat4x4_ortho(p, 0, (float)(width > 0 ? width : 1), (float)(height > 0 ? height : 1), 0, -1, 1);
+    mat4x4_mul(mvp, m, p);
+
+    glUseProgram(prog.program);
+    glUniformMatrix4fv(prog.mvp_location, 1, GL_FALSE, (const GLfloat*) mvp);
+    for(i = 0; i < sheet->atlasCount; i++) {
+      int first = i * THUMBS_PER_ATLAS;
+      int quads = count - first < THUMBS_PER_ATLAS ? count - first : THUMBS_PER_ATLAS;
+      glBindTexture(GL_TEXTURE_2D, textures[i]);
+      glDrawArrays(GL_TRIANGLES, first * 6, quads * 6);
+    }
+
+    glfwSwapBuffers(window);
+    glfwPollEvents();
+    //everything polled above has been uploaded, so finished atlases can go if memory is short
+    memEnforce();
+  }
+
+  memUntrack(&textureBlock);
+  glDeleteTextures(sheet->atlasCount, textures);
+  contactSheetFree(sheet);
+  free(textures);
+  free(vertexes);
+  free(ready);
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return 0;
+}
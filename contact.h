@@ -0,0 +1,62 @@
+#ifndef CONTACT_H
+#define CONTACT_H
+
+#include <pthread.h>
+#include "budget.h"
+
+//size of one thumbnail slot, and of the atlas textures the slots are packed into
+#define THUMB_SIZE 128
+#define ATLAS_SIZE 2048
+#define THUMBS_PER_ROW (ATLAS_SIZE / THUMB_SIZE)
+#define THUMBS_PER_ATLAS (THUMBS_PER_ROW * THUMBS_PER_ROW)
+
+enum {
+  THUMB_PENDING = 0,
+  THUMB_READY,
+  THUMB_FAILED
+};
+
+typedef struct {
+  const char* path;
+  int atlas;        //atlas page the slot lives on
+  int x, y;         //pixel offset of the slot inside the atlas
+  int w, h;         //size of the decoded thumbnail, at most THUMB_SIZE
+  int state;
+} Thumb;
+
+typedef struct {
+  Thumb* thumbs;
+  int count;
+
+  //CPU copies of the atlases, ATLAS_SIZE * ATLAS_SIZE RGB each. an atlas is freed when memory gets
+  //short once every thumbnail on it has been handed out by contactSheetPoll
+  unsigned char** atlases;
+  int atlasCount;
+  int* pending;     //thumbnails per atlas not yet polled
+  MemBlock block;
+
+  pthread_t* workers;
+  int workerCount;
+  int next;         //next thumbnail to claim, taken with an atomic add
+
+  //indexes of thumbnails finished since the last poll
+  pthread_mutex_t lock;
+  int* finished;
+  int finishedCount;
+} ContactSheet;
+
+// collect every .ppm and .pgm in a directory, sorted by name. returns the count, or -1 if the
+// directory is unreadable or memory ran out. the list is the caller's to give to freePpmPaths
+int collectPpmPaths(const char* dir, char*** paths);
+void freePpmPaths(char** paths, int count);
+// lay out the grid and start decoding thumbnails on worker threads
+ContactSheet* contactSheetStart(char** paths, int count);
+// copy out up to max indexes of thumbnails that finished since the last call. their pixels stay in the
+// atlases until the next memEnforce
+int contactSheetPoll(ContactSheet* sheet, int* ready, int max);
+// wait for the workers and release everything
+void contactSheetFree(ContactSheet* sheet);
+// open a window showing the grid, returns when it is closed
+int runContactSheet(char** paths, int count);
+
+#endif
@@ -1,393 +1,1070 @@
-#include <OpenGL/gl.h>
-#include <GLFW/glfw3.h>
-
-#include "linmath.h"
+#include "ezview.h"
+#include "imagewindow.h"
+#include "contact.h"
+#include "sampling.h"
+#include "pnm.h"
+#include "sequence.h"
+#include "shm.h"
+#include "stream.h"
+#include "softrender.h"
+#include "budget.h"
+#include "filter.h"
+#include "glfilter.h"
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <assert.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
-#define SIZE 256
-
-//global variables for paramaters changed by input callbacks
-float angle = 0;
-float scale = 1;
-float shear = 0;
-float xTran = 0;
-float yTran = 0;
-
-
-typedef struct {
-  float Position[2];
-  float TexCoord[2];
-} Vertex;
-
-// (-1, 1)  (1, 1)
-// (-1, -1) (1, -1)
-//Define the vertexes for the rectangle being drawn on
-Vertex vertexes[] = {
-  {{1, -1},  {0.99999, 0.99999}},
-  {{1, 1}, {0.99999, 0}},
-  {{-1, -1}, {0, 0.99999}},
-  {{-1, 1}, {0, 0}}
-};
-//Define the two triangles of the square
-GLuint indices[] = {
-    0, 1, 3,   // First Triangle
-    2, 0, 3     // Second Triangle
-};
-
-
-//vertex shader code
-static const char* vertex_shader_text =
-"uniform mat4 MVP;\n"
-"attribute vec2 TexCoordIn;\n"
-"attribute vec2 vPos;\n"
-"varying vec2 TexCoordOut;\n"
-"void main()\n"
-"{\n"
-"    gl_Position = MVP * vec4(vPos, 0.0, 1.0);\n"
-"    TexCoordOut = TexCoordIn;\n"
-"}\n";
-
-//fragment shader code
-static const char* fragment_shader_text =
-"varying vec2 TexCoordOut;\n"
-"uniform sampler2D Texture;\n"
-"void main()\n"
-"{\n"
-"    gl_FragColor = texture2D(Texture, TexCoordOut);\n"
-"}\n";
 
 //generic error handling
-static void error_callback(int error, const char* description)
+void error_callback(int error, const char* description)
 {
     fprintf(stderr, "Error: %s\n", description);
 }
 
+//the GL modules ask the window system about the current context through these
+int glHasExtension(const char* name)
+{
+  return glfwExtensionSupported(name);
+}
+
+void* glProcAddress(const char* name)
+{
+  return (void*)glfwGetProcAddress(name);
+}
+
 //handle all user input from the keyboard
-static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+    View* view = glfwGetWindowUserPointer(window);
+
     //if the escape key is pressed, close the window
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GLFW_TRUE);
 
     // Shear the image to the right with the 'S' key
       if (key == GLFW_KEY_S && action == GLFW_PRESS)
-        shear += .05;
+        view->shear += .05;
 
     // Shear the image to the left with the 'A' key
       if (key == GLFW_KEY_A && action == GLFW_PRESS)
-        shear -= .05;
+        view->shear -= .05;
 
     // Pan the image to the left with the 'LEFT' key
       if (key == GLFW_KEY_LEFT && action == GLFW_PRESS)
-        xTran += .05;
+        view->xTran += .05;
 
     // Pan the image to the right with the 'RIGHT' key
       if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS)
-        xTran -= .05;
+        view->xTran -= .05;
 
     // Pan the image down with the 'DOWN' key
       if (key == GLFW_KEY_DOWN && action == GLFW_PRESS)
-        yTran += .05;
+        view->yTran += .05;
 
     // Pan the image up with the 'UP' key
       if (key == GLFW_KEY_UP && action == GLFW_PRESS)
-        yTran -= .05;
+        view->yTran -= .05;
 
     // Rotate the image to the right using the 'R' key
     if(key == GLFW_KEY_R && action == GLFW_PRESS){
-      angle -= 1;
-      if(angle >= 4) angle = 0;
+      view->angle -= 1;
+      if(view->angle >= 4) view->angle = 0;
+    }
+
+  // Toggle between quality and performance sampling with the 'Q' key
+    if(key == GLFW_KEY_Q && action == GLFW_PRESS)
+      view->sampleQuality = !view->sampleQuality;
+
+  // Show memory use in the title with the 'M' key, and dump what is held where
+    if(key == GLFW_KEY_M && action == GLFW_PRESS) {
+      view->showMemory = !view->showMemory;
+      memDump(stderr);
     }
 
   // Rotate the image to the left using the 'E' key
     if(key == GLFW_KEY_E && action == GLFW_PRESS ){
-      angle += 1;
-      if(angle <= -4) angle = 0;
+      view->angle += 1;
+      if(view->angle <= -4) view->angle = 0;
+    }
+
+    //let the current mode handle its own keys, and redraw for anything that may have changed
+    if(action == GLFW_PRESS || action == GLFW_REPEAT) {
+      if(view->onKey) view->onKey(view, key, mods);
+      view->dirty = 1;
     }
 }
 
 //handle zoom using a callback to the scroll
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+  View* view = glfwGetWindowUserPointer(window);
+
   //scale the image using the y axis offset from the scroll
-  scale += (float)yoffset / 100;
-  if(scale <= 0) scale = 0;
+  view->scale += (float)yoffset / 100;
+  if(view->scale <= 0) view->scale = 0;
+  view->dirty = 1;
 }
 
-// Program to handle the compiling of the shader, and upon failure the calling of an error and exit of the program
-void glCompileShaderOrDie(GLuint shader) {
-  GLint compiled;
-  glCompileShader(shader);
-  glGetShaderiv(shader,
-		GL_COMPILE_STATUS,
-		&compiled);
-  if (!compiled) {
-    GLint infoLen = 0;
-    glGetShaderiv(shader,
-		  GL_INFO_LOG_LENGTH,
-		  &infoLen);
-    char* info = malloc(infoLen+1);
-    GLint done;
-    glGetShaderInfoLog(shader, infoLen, &done, info);
-    printf("Unable to compile shader: %s\n", info);
-    exit(1);
-  }
+//the window contents were lost or resized, draw them again
+void refresh_callback(GLFWwindow* window)
+{
+  View* view = glfwGetWindowUserPointer(window);
+  view->dirty = 1;
 }
 
-// Program to handle the linking of the program, and upon failure the calling of an error and exit of the program
-void glLinkProgramOrDie(GLuint program) {
-  GLint linked;
-  glLinkProgram(program);
-  glGetProgramiv(program,
-		GL_LINK_STATUS,
-		&linked);
-  if (!linked) {
-    GLint infoLen = 0;
-    glGetProgramiv(program,
-		  GL_INFO_LOG_LENGTH,
-		  &infoLen);
-    char* info = malloc(infoLen+1);
-    GLint done;
-    glGetProgramInfoLog(program, infoLen, &done, info);
-    printf("Unable to link program: %s\n", info);
-    exit(1);
-  }
+void viewInit(View* view)
+{
+  memset(view, 0, sizeof(View));
+  view->scale = 1;
+  view->sampleQuality = 1;
+  view->dirty = 1;
 }
 
-// method used to handle the loading of the image to be viewed, in .ppm format
-unsigned char* loadImage(FILE* inFile, int* width, int* height){
-  //buffer used for the comments mainly
-  char buff[SIZE], *fh;
+void attachView(GLFWwindow* window, View* view)
+{
+  //set the callbacks for the input
+  glfwSetWindowUserPointer(window, view);
+  glfwSetKeyCallback(window, key_callback);
+  glfwSetScrollCallback(window, scroll_callback);
+  glfwSetWindowRefreshCallback(window, refresh_callback);
+}
 
-  int w, h;
-  unsigned char* image;
-  int read;
-  unsigned int maxColors;
+// compose the user's view transform from the values set by the input callbacks
+void viewTransform(View* view, mat4x4 m) {
+  //matrix used for the shear operation
+  mat4x4 sh = {
+      {1.0f, 0.0f, 0.0f, 0.0f},
+      {view->shear, 1.0f, 0.0f, 0.0f},
+      {0.0f, 0.0f, 1.0f, 0.0f},
+      {0.0f, 0.0f, 0.0f, 1.0f}
+  };
+  //matrix used for the zoom operation
+  mat4x4 zoom = {
+      {view->scale, 0.0f, 0.0f, 0.0f},
+      {0.0, view->scale, 0.0f, 0.0f},
+      {0.0f, 0.0f, 1.0f, 0.0f},
+      {0.0f, 0.0f, 0.0f, 1.0f}
+  };
+
+  //set up matrix for transformation
+  mat4x4_identity(m);
+  //apply shear
+  mat4x4_mul(m, sh, m);
+  //apply zoom
+  mat4x4_mul(m, zoom, m);
+  //apply translate
+  mat4x4_translate_in_place(m, view->xTran, view->yTran, 1.0);
+  //apply rotate
+  mat4x4_rotate_Z(m, m, (view->angle * M_PI/2));
+}
+
+//when main was entered, and whether --timing asked for the startup phases to be printed
+static double startTime;
+static int reportTiming;
+
+static double monotonicSeconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
+//print how long a startup phase took and how far into the run it ended
+static void reportPhase(const char* name, double start, double end)
+{
+  if(reportTiming)
+    fprintf(stderr, "%-22s %8.2f ms   done at %8.2f ms\n", name, (end - start) * 1000, (end - startTime) * 1000);
+}
 
-  fh = (char *)malloc(sizeof(char) * SIZE);
-  fh = fgets(buff, SIZE, inFile);             //Make sure we are reading the right type of file
-  if ( (fh == NULL) || ( strncmp(buff, "P6\n", 3) != 0 ) ) perror("Please provide a P6 .ppm file for conversion\n");
+// read the header of the image to be viewed, leaving the file at the start of the pixels
+static int loadImageHeader(FILE* inFile, PnmHeader* hdr){
+  int result;
 
-  //get rid of comments
-  do
-        {
-           fh = fgets(buff, SIZE, inFile);      //write the comments into the out file
-           if ( fh == NULL ) return NULL;
-        } while ( strncmp(buff, "#", 1) == 0 );
+  //Make sure we are reading the right type of file
+  result = pnmReadHeader(inFile, hdr);
+  if(result != PNM_OK) {
+    fprintf(stderr, "Unable to read image: %s\n", pnmErrorString(result));
+    return 0;
+  }
+  //GL takes signed sizes, and the RGB copy is bigger than the payload for P5 and smaller for 16 bit
+  if(hdr->width > 0x7FFFFFFF || hdr->height > 0x7FFFFFFF ||
+     (size_t)hdr->width * hdr->height > SIZE_MAX / 3) {
+    fprintf(stderr, "Unable to read image: %s\n", pnmErrorString(PNM_ERR_OVERFLOW));
+    return 0;
+  }
+  return 1;
+}
 
-  //read in the width and height
-  read = sscanf(buff, "%u %u", &w, &h);
+// read the pixels that follow the header, as 8 bit RGB
+static unsigned char* loadPixels(FILE* inFile, const PnmHeader* hdr){
+  unsigned char *raw, *image;
 
-  //throw error if the width and height aren't in the file
-  if(read < 2) {
-    perror("File Unreadable. Please check the file format\n");
+  raw = malloc(hdr->payloadBytes);
+  if(raw == NULL) {
+    perror("Unable to allocate the image");
     return NULL;
   }
-
-  read = fscanf(inFile, "%u", &maxColors);
-  printf("%d\n", maxColors);
-  //check that the right color format is used
-  if(maxColors != 255 || read != 1) {
-    perror("Please provide an 24-bit color file");
+  //Read the image data from the file
+  if(fread(raw, 1, hdr->payloadBytes, inFile) != hdr->payloadBytes) {
+    fprintf(stderr, "Unable to read image: file is truncated\n");
+    free(raw);
     return NULL;
   }
 
-  fseek(inFile, 1, SEEK_CUR);
-  image = (unsigned char *)malloc(sizeof(char)* 3 * w * h);
-  //Read the image data from the file
-  fread(image, sizeof(unsigned char), w * h * 3, inFile);
+  //8 bit P6 is what we draw, anything else gets expanded to it
+  if(hdr->format == 6 && hdr->maxval == 255)
+    return raw;
 
-  *width = w;
-  *height = h;
+  image = malloc((size_t)hdr->width * hdr->height * 3);
+  if(image != NULL) pnmToRgb8(image, raw, hdr, hdr->height);
+  free(raw);
+  if(image == NULL)
+    perror("Unable to allocate the image");
   return image;
 }
 
-int main(int argc, char *argv[])
+//an image being read and mipmapped on a thread while the windows and program are set up
+typedef struct {
+  FILE* file;
+  PnmHeader hdr;
+  unsigned char* image;
+  MipChain chain;
+  int ok;
+  double start, decoded, mipped;
+  MemBlock imageBlock, chainBlock;
+} ImageLoad;
+
+//bytes in the levels of a mip chain after the first
+static size_t chainBytes(const MipChain* chain)
 {
-  //Check for propper arguments
-  if(argc < 2 || argc > 2) {
-    perror("Usage: ./ezview image-source.ppm \n");
+  size_t bytes = 0;
+  int level;
+  for(level = 1; level < chain->levels; level++)
+    bytes += (size_t)chain->width[level] * chain->height[level] * 3;
+  return bytes;
+}
+
+static void* imageLoadThread(void* arg)
+{
+  ImageLoad* load = arg;
+
+  load->start = monotonicSeconds();
+  load->image = loadPixels(load->file, &load->hdr);
+  load->decoded = monotonicSeconds();
+  if(load->image != NULL) {
+    memTrack(&load->imageBlock, MEM_CPU, "image pixels", (size_t)load->hdr.width * load->hdr.height * 3, NULL, NULL);
+    load->ok = buildMipChain(&load->chain, load->image, (int)load->hdr.width, (int)load->hdr.height);
+    if(!load->ok) perror("Unable to allocate the mipmaps");
+    else memTrack(&load->chainBlock, MEM_CPU, "mipmaps", chainBytes(&load->chain), NULL, NULL);
+  }
+  load->mipped = monotonicSeconds();
+  return NULL;
+}
+
+//one window looking at the shared image, with its own view and frame pacing
+typedef struct {
+  GLFWwindow* window;
+  View view;
+  double interval;      //seconds between redraws, from the refresh rate of its monitor
+  double nextFrame;
+  int closed;
+  int titleShowsMemory;
+  int titleFilters;     //generation of the filters named in the title
+} ViewWindow;
+
+//which parts of the image are held where, so the memory budget can drop what the views don't need
+typedef struct {
+  const char* path;
+  ImageLoad* load;          //load->image is the CPU copy, NULL once it has been dropped
+  MemBlock texture;
+  GLFWwindow* context;
+  Sampling* sampling;
+  GLuint texID;
+  int levels;               //in the full chain
+  int baseLevel;            //finest level of the full chain that is on the GPU
+  int neededLevel;          //finest level any window samples at its current zoom
+} Residency;
+
+//bytes taken on the GPU by the levels from base down. drivers keep RGB as 4 bytes a texel
+static size_t textureBytes(int w, int h, int base)
+{
+  size_t bytes = 0;
+  int level;
+
+  for(level = 0; ; level++) {
+    if(level >= base) bytes += (size_t)w * h * 4;
+    if(w == 1 && h == 1) break;
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
   }
+  return bytes;
+}
+
+//once the image is on the GPU the CPU copy is only kept to bring back dropped levels quickly
+static int dropImageCopy(MemBlock* block)
+{
+  Residency* res = block->user;
+
+  free(res->load->image);
+  res->load->image = NULL;
+  memUntrack(block);
+  return 1;
+}
+
+//read the pixels again after the copy was dropped
+static int reloadImage(Residency* res)
+{
+  ImageLoad* load = res->load;
+  FILE* f = fopen(res->path, "rb");
+  PnmHeader hdr;
 
-  if(strstr(argv[1], ".ppm") == NULL) {
-    perror("Please provide a .ppm file tp be read");
+  if(f == NULL) {
+    perror("Unable to open the image again");
     return 0;
   }
+  if(loadImageHeader(f, &hdr) && hdr.width == load->hdr.width && hdr.height == load->hdr.height)
+    load->image = loadPixels(f, &hdr);
+  fclose(f);
+  if(load->image == NULL) return 0;
 
-  //open the image file
-  FILE *inFile = fopen(argv[1], "rb");
+  memTrack(&load->imageBlock, MEM_CPU, "image pixels", (size_t)hdr.width * hdr.height * 3, dropImageCopy, res);
+  return 1;
+}
 
-  GLint image_width, image_height;
+//replace the texture with one holding the levels from base down. dropped levels are read back from
+//the GPU, they are a third of the size at most, and levels coming back are rebuilt from the CPU copy
+static int setResidentLevels(Residency* res, int base)
+{
+  int w = (int)res->load->hdr.width, h = (int)res->load->hdr.height;
+  MipChain chain, part;
+  GLuint tex;
+  int level;
+
+  memset(&chain, 0, sizeof(MipChain));
+  memset(&part, 0, sizeof(MipChain));
+  glfwMakeContextCurrent(res->context);
+
+  if(base > res->baseLevel) {
+    glBindTexture(GL_TEXTURE_2D, res->texID);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for(level = 0; level < res->levels - base; level++) {
+      int l = base + level;
+      part.width[level] = w >> l > 0 ? w >> l : 1;
+      part.height[level] = h >> l > 0 ? h >> l : 1;
+      part.data[level] = malloc((size_t)part.width[level] * part.height[level] * 3);
+      if(part.data[level] == NULL) break;
+      part.levels = level + 1;
+      glGetTexImage(GL_TEXTURE_2D, l - res->baseLevel, GL_RGB, GL_UNSIGNED_BYTE, part.data[level]);
+    }
+    if(part.levels != res->levels - base) {
+      for(level = 0; level < part.levels; level++) free(part.data[level]);
+      return 0;
+    }
+  } else {
+    if(res->load->image == NULL && !reloadImage(res)) return 0;
+    if(!buildMipChain(&chain, res->load->image, w, h)) return 0;
+    memTouch(&res->load->imageBlock);
+    part.levels = chain.levels - base;
+    for(level = 0; level < part.levels; level++) {
+      part.width[level] = chain.width[base + level];
+      part.height[level] = chain.height[base + level];
+      part.data[level] = chain.data[base + level];
+    }
+  }
 
-  //read in the image file and store it
-  GLubyte* image = (GLubyte*) loadImage(inFile, &image_width, &image_height);
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  uploadMipChain(&part);
+  glDeleteTextures(1, &res->texID);
+  res->texID = tex;
+  //filtering is per texture, so the new one has to be set up from scratch
+  samplingInit(res->sampling);
+
+  if(base > res->baseLevel) {
+    for(level = 0; level < part.levels; level++) free(part.data[level]);
+  } else {
+    freeMipChain(&chain);
+  }
+  res->baseLevel = base;
+  memResize(&res->texture, textureBytes(w, h, base));
+  return 1;
+}
 
-    GLFWwindow* window;
-    GLuint vertex_buffer, vertex_shader, fragment_shader, program;
-    GLint mvp_location, vpos_location, vcol_location;
+//the finest levels are the bulk of the texture, drop any the windows are too zoomed out to use
+static int dropTextureLevels(MemBlock* block)
+{
+  Residency* res = block->user;
+
+  if(res->neededLevel <= res->baseLevel) return 0;
+  return setResidentLevels(res, res->neededLevel);
+}
+
+//finest level of the full chain a window samples at its zoom. rotation can swap the axes and shear
+//brings in anisotropic filtering, so this errs towards a finer level
+static int windowLevel(ViewWindow* vw, int w, int h, int levels)
+{
+  int fw, fh, level;
+  float lod;
+
+  glfwGetFramebufferSize(vw->window, &fw, &fh);
+  if(fw <= 0 || fh <= 0 || vw->view.scale <= 0) return levels - 1;
+
+  lod = log2f((w < h ? w : h) / ((fw > fh ? fw : fh) * vw->view.scale));
+  //the sharpest bias samplingUpdate uses, and up to 8x anisotropy
+  lod += samplingBias(1, exp2f(lod));
+  if(vw->view.shear != 0) lod -= 3;
+
+  level = lod <= 0 ? 0 : (int)lod;
+  return level < levels - 1 ? level : levels - 1;
+}
+
+//settings taken from the command line
+typedef struct {
+  int windows;
+  const char* sequence;
+  double fps;
+  const char* shm;
+  int timing;
+  int cpu;
+  const char* output;
+  int outWidth, outHeight;
+  View view;
+  int threads;
+  int memStats;
+  FilterChain filters;
+  char** files;
+  int fileCount;
+} Options;
+
+static void usage(void)
+{
+  fprintf(stderr,
+          "Usage: ./ezview [options] image-source.ppm\n"
+          "       renderer | ./ezview -   (or a named pipe instead of -)\n"
+          "       ./ezview a.ppm b.ppm ... | ./ezview directory/\n"
+          "Options:\n"
+          "  --windows N   show the image in N windows, spread over the monitors\n"
+          "  --seq PATTERN play numbered frames, e.g. --seq frame_%%04d.ppm\n"
+          "  --fps N       playback rate for --seq, 24 by default\n"
+          "  --shm NAME    show frames published to a shared memory segment by a producer\n"
+          "  --timing      print how long each step of opening an image takes\n"
+          "  --backend B   draw with gl (the default) or on the cpu, for machines without working GL\n"
+          "  --output FILE draw one frame on the cpu into a .ppm file without opening a window\n"
+          "  --size WxH    size of the --output frame, the image size by default\n"
+          "  --view Z,S,R,X,Y  zoom, shear, quarter turns and pan for --output, e.g. --view 2,0,1,0.1,0\n"
+          "  --threads N   threads drawing for the cpu backend, one per core by default\n"
+          "  --mem-budget CPU[,GPU]  megabytes ezview may hold before dropping what it can rebuild.\n"
+          "                half of physical memory and no GPU limit by default\n"
+          "  --mem-stats   print what memory was held where on exit\n"
+          "  --filter SPEC filter the image, e.g. --filter blur:4 or --filter sharpen:2:1.5,edges:1.\n"
+          "                stages are blur, sharpen and edges, each with a radius and sharpen with an amount\n");
+}
+
+//pull out the -- options and leave the file names behind. returns 0 on a bad option
+static int parseOptions(int argc, char* argv[], Options* opts)
+{
+  int i;
+
+  memset(opts, 0, sizeof(Options));
+  memDefaultBudgets();
+  opts->windows = 1;
+  opts->fps = 24;
+  viewInit(&opts->view);
+  opts->files = malloc(sizeof(char*) * argc);
+
+  for(i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+      opts->windows = atoi(argv[++i]);
+      if(opts->windows < 1) return 0;
+    } else if(strcmp(argv[i], "--seq") == 0 && i + 1 < argc) {
+      opts->sequence = argv[++i];
+    } else if(strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+      opts->shm = argv[++i];
+    } else if(strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+      opts->fps = atof(argv[++i]);
+      if(opts->fps <= 0) return 0;
+    } else if(strcmp(argv[i], "--timing") == 0) {
+      opts->timing = 1;
+    } else if(strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+      i++;
+      if(strcmp(argv[i], "cpu") == 0) opts->cpu = 1;
+      else if(strcmp(argv[i], "gl") == 0) opts->cpu = 0;
+      else return 0;
+    } else if(strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      opts->output = argv[++i];
+    } else if(strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      if(sscanf(argv[++i], "%dx%d", &opts->outWidth, &opts->outHeight) != 2 ||
+         opts->outWidth < 1 || opts->outHeight < 1) return 0;
+    } else if(strcmp(argv[i], "--view") == 0 && i + 1 < argc) {
+      View* v = &opts->view;
+      if(sscanf(argv[++i], "%f,%f,%f,%f,%f", &v->scale, &v->shear, &v->angle, &v->xTran, &v->yTran) < 1)
+        return 0;
+    } else if(strcmp(argv[i], "--mem-budget") == 0 && i + 1 < argc) {
+      double cpu = 0, gpu = 0;
+      int n = sscanf(argv[++i], "%lf,%lf", &cpu, &gpu);
+      if(n < 1 || cpu < 0 || gpu < 0) return 0;
+      memSetBudget(MEM_CPU, (size_t)(cpu * 1024 * 1024));
+      if(n == 2) memSetBudget(MEM_GPU, (size_t)(gpu * 1024 * 1024));
+    } else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      if(!filterParse(&opts->filters, argv[++i])) return 0;
+    } else if(strcmp(argv[i], "--mem-stats") == 0) {
+      opts->memStats = 1;
+    } else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      opts->threads = atoi(argv[++i]);
+      if(opts->threads < 1) return 0;
+    } else if(strncmp(argv[i], "--", 2) == 0) {
+      return 0;
+    } else {
+      opts->files[opts->fileCount++] = argv[i];
+    }
+  }
+  return 1;
+}
+
+//F steps the last filter through blur, sharpen, edges and off, - and = shrink and grow its radius
+static void filterKey(View* view, int key, int mods)
+{
+  FilterChain* chain = view->user;
+
+  if(key == GLFW_KEY_F)
+    filterCycle(chain);
+  else if(key == GLFW_KEY_MINUS)
+    filterAdjustRadius(chain, -1);
+  else if(key == GLFW_KEY_EQUAL)
+    filterAdjustRadius(chain, 1);
+}
+
+// show one image in windowCount windows. the windows share a context, so the image is uploaded once
+static int runImageViewer(const char* path, int windowCount, const FilterChain* filters)
+{
+  ImageLoad load;
+  pthread_t loader;
+  int threaded;
+  double mark;
+
+  memset(&load, 0, sizeof(ImageLoad));
+  //open the image file
+  load.file = fopen(path, "rb");
+  if(load.file == NULL) {
+    perror("Unable to open the image");
+    return 1;
+  }
+
+  //the header is enough to size the windows, the pixels are read while GL starts up
+  mark = monotonicSeconds();
+  if(!loadImageHeader(load.file, &load.hdr)) {
+    fclose(load.file);
+    return 1;
+  }
+  reportPhase("header", mark, monotonicSeconds());
+  threaded = pthread_create(&loader, NULL, imageLoadThread, &load) == 0;
+  if(!threaded)
+    imageLoadThread(&load);
+
+  GLint image_width = (GLint)load.hdr.width, image_height = (GLint)load.hdr.height;
+
+    ViewWindow* windows;
+    GLFWmonitor** monitors;
+    GLuint vertex_buffer, EBO, texID;
+    ImageProgram prog;
+    Sampling sampling;
+    Residency res;
+    FilterChain chain = *filters;
+    GlFilter glFilter;
+    //filterState is 1 once the filter program is built and -1 if the GPU can't run it
+    int filterState = 0, filtered = 0, filteredGeneration = -1, filteredBase = -1;
+    GLuint filteredTex = 0;
+    int i, monitorCount = 0, cached, firstShown = 0;
 
 
     glfwSetErrorCallback(error_callback);
 
     //initialize glfw
+    mark = monotonicSeconds();
     if (!glfwInit())
         exit(EXIT_FAILURE);
+    reportPhase("glfw init", mark, monotonicSeconds());
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
 
-    //create the glfw window, use the image to set width and height, and file name for title
-    window = glfwCreateWindow(image_width, image_height, argv[1], NULL, NULL);
-    if (!window)
-    {   //terminate if unable to open
-        glfwTerminate();
-        exit(EXIT_FAILURE);
+    monitors = glfwGetMonitors(&monitorCount);
+    windows = calloc(windowCount, sizeof(ViewWindow));
+
+    mark = monotonicSeconds();
+    for(i = 0; i < windowCount; i++) {
+      ViewWindow* vw = &windows[i];
+      GLFWmonitor* monitor = monitorCount > 0 ? monitors[i % monitorCount] : NULL;
+      const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+      int w = image_width, h = image_height;
+
+      //keep each window on its monitor
+      if(mode && w > mode->width) w = mode->width;
+      if(mode && h > mode->height) h = mode->height;
+
+      //create the glfw window, use the image to set width and height, and file name for title.
+      //every window after the first shares the first one's textures, buffers and program
+      vw->window = glfwCreateWindow(w, h, path, NULL, i ? windows[0].window : NULL);
+      if (!vw->window)
+      {   //terminate if unable to open
+          glfwTerminate();
+          exit(EXIT_FAILURE);
+      }
+      if(monitorCount > 1) {
+        int mx, my;
+        glfwGetMonitorPos(monitor, &mx, &my);
+        glfwSetWindowPos(vw->window, mx + 40 * (1 + i / monitorCount), my + 40 * (1 + i / monitorCount));
+      }
+
+      viewInit(&vw->view);
+      attachView(vw->window, &vw->view);
+      vw->view.onKey = filterKey;
+      vw->view.user = &chain;
+      vw->titleFilters = -1;
+      vw->interval = 1.0 / (mode && mode->refreshRate > 0 ? mode->refreshRate : 60);
+
+      glfwMakeContextCurrent(vw->window);
+      //with several windows, blocking on vsync in each swap would divide the frame rate between them
+      glfwSwapInterval(windowCount == 1 ? 1 : 0);
+
+      if(i == 0) {
+        double programStart;
+
+        reportPhase("window and context", mark, monotonicSeconds());
+        createImageQuad(&vertex_buffer, &EBO);
+        programStart = monotonicSeconds();
+        cached = createImageProgram(&prog);
+        reportPhase(cached ? "program (cached)" : "program (compiled)", programStart, monotonicSeconds());
+
+        //setup textures, the pixels go in once the loader is done
+        glGenTextures(1, &texID);
+        glBindTexture(GL_TEXTURE_2D, texID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        samplingInit(&sampling);
+      }
+
+      //buffer bindings and attribute pointers belong to each context, not the share group
+      glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+      bindVertexLayout(&prog);
+      glUseProgram(prog.program);
+      glEnable( GL_TEXTURE_2D );
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, texID);
+      glUniform1i(prog.tex_location, 0);
     }
 
-    //set the callbacks for the input
-    glfwSetKeyCallback(window, key_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-
-    glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
-
-    //set up the element buffer object
-    GLuint EBO;
-    glGenBuffers(1, &EBO);
-
-
-    glGenBuffers(1, &vertex_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertexes), vertexes, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    //element buffer object used for indeces
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-    sizeof(indices), indices, GL_STATIC_DRAW);
-
-    //initialize the vertex shader
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_text, NULL);
-    glCompileShaderOrDie(vertex_shader);
-
-    //initialize the fragment shader
-    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_text, NULL);
-    glCompileShaderOrDie(fragment_shader);
-
-    // Create the program
-    program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgramOrDie(program);
-
-    //set the mvp location from the vertex shader
-    mvp_location = glGetUniformLocation(program, "MVP");
-    assert(mvp_location != -1);
-
-    //set the vpos location from the vertex shader
-    vpos_location = glGetAttribLocation(program, "vPos");
-    assert(vpos_location != -1);
-    //set the texture coordinate location from the fragment shader
-    GLint texcoord_location = glGetAttribLocation(program, "TexCoordIn");
-    assert(texcoord_location != -1);
-    //set the texture location from the fragment shader
-    GLint tex_location = glGetUniformLocation(program, "Texture");
-    assert(tex_location != -1);
-
-
-    glEnableVertexAttribArray(vpos_location);
-    glVertexAttribPointer(vpos_location,
-			  2,
-			  GL_FLOAT,
-			  GL_FALSE,
-                          sizeof(Vertex),
-			  (void*) 0);
-
-    glEnableVertexAttribArray(texcoord_location);
-    glVertexAttribPointer(texcoord_location,
-			  2,
-			  GL_FLOAT,
-			  GL_FALSE,
-                          sizeof(Vertex),
-			  (void*) (sizeof(float) * 2));
-
-    //setup textures
-    GLuint texID;
-    glGenTextures(1, &texID);
-    glEnable( GL_TEXTURE_2D );
-    glBindTexture(GL_TEXTURE_2D, texID);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image_width, image_height, 0, GL_RGB,
-		 GL_UNSIGNED_BYTE, image);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texID);
-    glUniform1i(tex_location, 0);
+    //everything above ran alongside the read, only what is left of it is spent waiting here
+    mark = monotonicSeconds();
+    if(threaded)
+      pthread_join(loader, NULL);
+    fclose(load.file);
+    reportPhase("wait for loader", mark, monotonicSeconds());
+    reportPhase("read and decode", load.start, load.decoded);
+    reportPhase("mipmaps", load.decoded, load.mipped);
+    if(!load.ok) {
+      memUntrack(&load.imageBlock);
+      free(load.image);
+      for(i = 0; i < windowCount; i++)
+        glfwDestroyWindow(windows[i].window);
+      free(windows);
+      glfwTerminate();
+      return 1;
+    }
 
-    //main program loop
-    while (!glfwWindowShouldClose(window))
+    //upload the image with a gamma-correct mip chain, filtering is picked per frame
+    mark = monotonicSeconds();
+    glfwMakeContextCurrent(windows[0].window);
+    glBindTexture(GL_TEXTURE_2D, texID);
+    uploadMipChain(&load.chain);
+    memset(&res, 0, sizeof(Residency));
+    res.path = path;
+    res.load = &load;
+    res.context = windows[0].window;
+    res.sampling = &sampling;
+    res.texID = texID;
+    res.levels = load.chain.levels;
+    memTrack(&res.texture, MEM_GPU, "image texture", textureBytes(image_width, image_height, 0), dropTextureLevels, &res);
+    //the GPU has its own copy now, the CPU one stays until memory gets short
+    memTrack(&load.imageBlock, MEM_CPU, "image pixels", (size_t)image_width * image_height * 3, dropImageCopy, &res);
+    memUntrack(&load.chainBlock);
+    freeMipChain(&load.chain);
+    reportPhase("upload", mark, monotonicSeconds());
+
+    //main program loop, each window is redrawn when its view changes but no faster than its monitor
+    for(;;)
     {
-        GLfloat ratio;
-        int width, height;
-        mat4x4 m, p, mvp, s;
-
-        //matrix used for the shear operation
-        mat4x4 sh = {
-            1.0f, 0.0f, 0.0f, 0.0f,
-            shear, 1.0f, 0.0f, 0.0f,
-            0.0f, 0.0f, 1.0f, 0.0f,
-            0.0f, 0.0f, 0.0f, 1.0f
-        };
-        //matrix used for the zoom operation
-        mat4x4 zoom = {
-            scale, 0.0f, 0.0f, 0.0f,
-            0.0, scale, 0.0f, 0.0f,
-            0.0f, 0.0f, 1.0f, 0.0f,
-            0.0f, 0.0f, 0.0f, 1.0f
-        };
-
-        glfwGetFramebufferSize(window, &width, &height);
-        ratio = width / (float) height;
+        double now = glfwGetTime(), wake = -1;
+        int open = 0, needed = res.levels - 1;
+
+        //bring back levels a window has zoomed in far enough to need, then settle up with the budget
+        for(i = 0; i < windowCount; i++) {
+          int level;
+          if(windows[i].closed) continue;
+          level = windowLevel(&windows[i], image_width, image_height, res.levels);
+          if(level < needed) needed = level;
+        }
+        res.neededLevel = needed;
+        if(needed < res.baseLevel) setResidentLevels(&res, needed);
+        memEnforce();
+
+        //run the filters again when they change or the texture under them is replaced. if the budget
+        //dropped the finest levels they run on the smaller copy that is left, with radii scaled to match
+        if(filterActive(&chain) && filterState >= 0 &&
+           (chain.generation != filteredGeneration || res.texID != filteredTex || res.baseLevel != filteredBase)) {
+          int fw = image_width >> res.baseLevel, fh = image_height >> res.baseLevel;
+
+          mark = monotonicSeconds();
+          glfwMakeContextCurrent(windows[0].window);
+          if(filterState == 0) filterState = glFilterInit(&glFilter) ? 1 : -1;
+          filtered = filterState > 0 && glFilterRun(&glFilter, &chain, res.texID, fw > 0 ? fw : 1,
+                                                    fh > 0 ? fh : 1, (float)(1 << res.baseLevel));
+          bindVertexLayout(&prog);
+          if(reportTiming) glFinish();
+          reportPhase("filter", mark, monotonicSeconds());
+          filteredGeneration = chain.generation;
+          filteredTex = res.texID;
+          filteredBase = res.baseLevel;
+          for(i = 0; i < windowCount; i++)
+            windows[i].view.dirty = 1;
+        }
+        if(!filterActive(&chain)) filtered = 0;
+
+        for(i = 0; i < windowCount; i++) {
+          ViewWindow* vw = &windows[i];
+          if(vw->closed) continue;
+
+          //the shared objects live as long as any window does, so just hide closed ones
+          if(glfwWindowShouldClose(vw->window)) {
+            glfwHideWindow(vw->window);
+            vw->closed = 1;
+            continue;
+          }
+          open++;
+
+          if(!vw->view.dirty) continue;
+          if(now < vw->nextFrame) {
+            if(wake < 0 || vw->nextFrame < wake) wake = vw->nextFrame;
+            continue;
+          }
+          vw->view.dirty = 0;
+          if(filtered) {
+            drawImageView(vw->window, &vw->view, &prog, &glFilter.sampling[glFilter.result],
+                          glFilter.output[glFilter.result], glFilter.width, glFilter.height);
+            memTouch(&glFilter.block);
+          } else {
+            drawImageView(vw->window, &vw->view, &prog, &sampling, res.texID,
+                          image_width >> res.baseLevel, image_height >> res.baseLevel);
+          }
+          memTouch(&res.texture);
+          vw->nextFrame = now + vw->interval;
+          if(vw->view.showMemory || vw->titleShowsMemory || vw->titleFilters != chain.generation) {
+            char title[1300], usage[128], names[128];
+            size_t used = snprintf(title, sizeof(title), "%s", path);
+            filterDescribe(&chain, names, sizeof(names));
+            if(filterActive(&chain) && used < sizeof(title))
+              used += snprintf(title + used, sizeof(title) - used, " - %s", names);
+            memDescribe(usage, sizeof(usage));
+            if(vw->view.showMemory && used < sizeof(title))
+              snprintf(title + used, sizeof(title) - used, " - %s", usage);
+            glfwSetWindowTitle(vw->window, title);
+            vw->titleShowsMemory = vw->view.showMemory;
+            vw->titleFilters = chain.generation;
+          }
+          if(!firstShown) {
+            reportPhase("time to first pixel", startTime, monotonicSeconds());
+            firstShown = 1;
+          }
+        }
+        if(!open) break;
+
+        if(wake >= 0) glfwWaitEventsTimeout(wake - now);
+        else glfwWaitEvents();
+    }
 
-        glViewport(0, 0, width, height);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        //set up matrix for transformation
-        mat4x4_identity(m);
-        //apply shear
-        mat4x4_mul(m, sh, m);
-        //apply zoom
-        mat4x4_mul(m, zoom, m);
-        //apply translate
-        mat4x4_translate_in_place(m, xTran, yTran, 1.0);
-        //apply rotate
-        mat4x4_rotate_Z(m, m, (angle * M_PI/2));
-
-        mat4x4_identity(p);
-        //apply all transformations
-        mat4x4_mul(mvp,p, m);
-
-        glUseProgram(program);
-        glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat*) mvp);
-        //draw the updated geometry to the screen
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    if(filterState > 0) {
+      glfwMakeContextCurrent(windows[0].window);
+      glFilterFree(&glFilter);
+    }
+    for(i = 0; i < windowCount; i++)
+      glfwDestroyWindow(windows[i].window);
+    free(windows);
+    memUntrack(&res.texture);
+    memUntrack(&load.imageBlock);
+    free(load.image);
+    //exit
+    glfwTerminate();
+    return 0;
+}
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+//levels for the CPU backend made from image with the filters applied
+static int softImageFiltered(SoftImage* img, const unsigned char* image, int w, int h,
+                             const FilterChain* chain, SoftRenderer* renderer)
+{
+  unsigned char* filtered = NULL;
+  MipChain mips;
+  int ok;
+
+  if(filterActive(chain)) {
+    filtered = malloc((size_t)w * h * 3);
+    if(filtered == NULL || !filterImage(filtered, image, w, h, chain, renderer)) {
+      free(filtered);
+      return 0;
     }
+    image = filtered;
+  }
+  ok = buildMipChain(&mips, (unsigned char*)image, w, h) && softImageInit(img, &mips);
+  freeMipChain(&mips);
+  free(filtered);
+  return ok;
+}
 
-    glfwDestroyWindow(window);
-    //exit
+//show frames drawn on the CPU. GL is only used to copy finished frames to the screen, which even
+//software GL implementations do quickly. the unfiltered image is kept to run changed filters on
+static int showSoftWindow(const char* path, SoftRenderer* renderer, SoftImage* img, const ImageLoad* load,
+                          const FilterChain* filters)
+{
+  GLFWwindow* window;
+  GLFWmonitor* monitor;
+  const GLFWvidmode* mode;
+  View view;
+  Framebuffer fb;
+  FilterChain chain = *filters;
+  mat4x4 m;
+  char title[1300], names[128];
+  int w = img->width[0], h = img->height[0], applied = chain.generation;
+  double filterMs = 0;
+
+  glfwSetErrorCallback(error_callback);
+  if (!glfwInit())
+    return 1;
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+
+  monitor = glfwGetPrimaryMonitor();
+  mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+  if(mode && w > mode->width) w = mode->width;
+  if(mode && h > mode->height) h = mode->height;
+
+  window = glfwCreateWindow(w, h, path, NULL, NULL);
+  if (!window) {
     glfwTerminate();
-    exit(EXIT_SUCCESS);
+    return 1;
+  }
+  viewInit(&view);
+  attachView(window, &view);
+  view.onKey = filterKey;
+  view.user = &chain;
+  glfwMakeContextCurrent(window);
+  glfwSwapInterval(1);
+  memset(&fb, 0, sizeof(Framebuffer));
+
+  while (!glfwWindowShouldClose(window)) {
+    if(chain.generation != applied) {
+      double start = glfwGetTime();
+      applied = chain.generation;
+      softImageFree(img);
+      if(!softImageFiltered(img, load->image, (int)load->hdr.width, (int)load->hdr.height, &chain, renderer))
+        perror("Unable to filter the image");
+      filterMs = (glfwGetTime() - start) * 1000;
+      view.dirty = 1;
+    }
+    if(view.dirty) {
+      int width, height;
+      double start;
+
+      view.dirty = 0;
+      glfwGetFramebufferSize(window, &width, &height);
+      if(width > 0 && height > 0 && framebufferResize(&fb, width, height)) {
+        viewTransform(&view, m);
+        start = glfwGetTime();
+        softRender(renderer, &fb, img, m, view.sampleQuality);
+        filterDescribe(&chain, names, sizeof(names));
+        if(filterActive(&chain))
+          snprintf(title, sizeof(title), "%s - %s - cpu %.1f ms, filter %.1f ms", path, names,
+                   (glfwGetTime() - start) * 1000, filterMs);
+        else
+          snprintf(title, sizeof(title), "%s - cpu %.1f ms", path, (glfwGetTime() - start) * 1000);
+        glfwSetWindowTitle(window, title);
+
+        //the framebuffer is stored top row first, GL draws from the bottom up
+        glViewport(0, 0, width, height);
+        glRasterPos2f(-1, 1);
+        glPixelZoom(1, -1);
+        glDrawPixels(width, height, GL_RGBA, GL_UNSIGNED_BYTE, fb.pixels);
+        glfwSwapBuffers(window);
+      }
+    }
+    glfwWaitEvents();
+  }
+
+  framebufferFree(&fb);
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return 0;
+}
+
+// draw the image with the CPU backend, in a window or, with --output, straight into a file
+static int runSoftViewer(const char* path, const Options* opts)
+{
+  ImageLoad load;
+  SoftImage img;
+  SoftRenderer* renderer;
+  int result = 0;
+  double mark;
+
+  memset(&load, 0, sizeof(ImageLoad));
+  load.file = fopen(path, "rb");
+  if(load.file == NULL) {
+    perror("Unable to open the image");
+    return 1;
+  }
+  if(!loadImageHeader(load.file, &load.hdr)) {
+    fclose(load.file);
+    return 1;
+  }
+  //nothing to overlap with here, so load on this thread
+  imageLoadThread(&load);
+  fclose(load.file);
+  reportPhase("read and decode", load.start, load.decoded);
+  reportPhase("mipmaps", load.decoded, load.mipped);
+  if(!load.ok) {
+    memUntrack(&load.imageBlock);
+    free(load.image);
+    return 1;
+  }
+  renderer = softRendererStart(opts->threads);
+  if(filterActive(&opts->filters)) {
+    mark = monotonicSeconds();
+    result = !softImageFiltered(&img, load.image, (int)load.hdr.width, (int)load.hdr.height, &opts->filters, renderer);
+    reportPhase("filter", mark, monotonicSeconds());
+  } else {
+    result = !softImageInit(&img, &load.chain);
+  }
+  //the RGBA levels are all the renderer reads from, a window keeps the pixels to filter them again
+  memUntrack(&load.chainBlock);
+  freeMipChain(&load.chain);
+  if(opts->output || result) {
+    memUntrack(&load.imageBlock);
+    free(load.image);
+    load.image = NULL;
+  }
+  if(result) {
+    perror("Unable to allocate the image");
+    softRendererStop(renderer);
+    return 1;
+  }
+
+  if(opts->output) {
+    View view = opts->view;
+    Framebuffer fb;
+    mat4x4 m;
+
+    memset(&fb, 0, sizeof(Framebuffer));
+    if(!framebufferResize(&fb, opts->outWidth ? opts->outWidth : img.width[0],
+                          opts->outHeight ? opts->outHeight : img.height[0])) {
+      perror("Unable to allocate the frame");
+      result = 1;
+    } else {
+      viewTransform(&view, m);
+      mark = monotonicSeconds();
+      softRender(renderer, &fb, &img, m, view.sampleQuality);
+      reportPhase("render", mark, monotonicSeconds());
+      if(!framebufferWritePpm(&fb, opts->output)) {
+        perror("Unable to write the frame");
+        result = 1;
+      }
+    }
+    framebufferFree(&fb);
+  } else {
+    result = showSoftWindow(path, renderer, &img, &load, &opts->filters);
+  }
+
+  softRendererStop(renderer);
+  softImageFree(&img);
+  memUntrack(&load.imageBlock);
+  free(load.image);
+  return result;
+}
+
+//pick what to show from the options
+static int runMode(Options* opts)
+{
+  struct stat st;
+
+  if(opts->sequence)
+    return runSequence(opts->sequence, opts->fps);
+  if(opts->shm)
+    return runShm(opts->shm);
+
+  //read from a pipe as the data arrives, these can't be seeked
+  if(opts->fileCount == 1 && strcmp(opts->files[0], "-") == 0)
+    return runStream("stdin", 0);
+  if(opts->fileCount == 1 && stat(opts->files[0], &st) == 0 && S_ISFIFO(st.st_mode)) {
+    int fd = open(opts->files[0], O_RDONLY);
+    if(fd < 0) {
+      perror("Unable to open the pipe");
+      return 1;
+    }
+    return runStream(opts->files[0], fd);
+  }
+
+  //several files, or a directory of them, are shown as a grid of thumbnails
+  if(opts->fileCount > 1)
+    return runContactSheet(opts->files, opts->fileCount);
+  if(stat(opts->files[0], &st) == 0 && S_ISDIR(st.st_mode)) {
+    char** paths = NULL;
+    int count = collectPpmPaths(opts->files[0], &paths), result;
+    if(count < 0) {
+      perror("Unable to read the directory");
+      return 1;
+    }
+    if(count == 0) {
+      freePpmPaths(paths, count);
+      fprintf(stderr, "No .ppm or .pgm files found in the directory\n");
+      return 0;
+    }
+    result = runContactSheet(paths, count);
+    freePpmPaths(paths, count);
+    return result;
+  }
+
+  if(strstr(opts->files[0], ".ppm") == NULL && strstr(opts->files[0], ".pgm") == NULL) {
+    perror("Please provide a .ppm or .pgm file tp be read");
+    return 0;
+  }
+
+  if(opts->cpu || opts->output)
+    return runSoftViewer(opts->files[0], opts);
+  return runImageViewer(opts->files[0], opts->windows, &opts->filters);
+}
+
+int main(int argc, char *argv[])
+{
+  Options opts;
+  int result;
+
+  startTime = monotonicSeconds();
+  //Check for propper arguments
+  if(!parseOptions(argc, argv, &opts) || (opts.fileCount < 1 && opts.sequence == NULL && opts.shm == NULL)) {
+    usage();
+    return 0;
+  }
+  reportTiming = opts.timing;
+
+  result = runMode(&opts);
+  if(opts.memStats)
+    memDump(stderr);
+  return result;
 }
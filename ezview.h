@@ -0,0 +1,38 @@
+#ifndef EZVIEW_H
+#define EZVIEW_H
+
+#include "imageprog.h"
+#include <GLFW/glfw3.h>
+
+#include "linmath.h"
+
+//paramaters changed by the input callbacks, one per window
+typedef struct View {
+  float angle;
+  float scale;
+  float shear;
+  float xTran;
+  float yTran;
+  int sampleQuality;
+  int showMemory;     //memory use goes in the window title
+  int dirty;          //something changed and the window needs drawing again
+
+  //keys not used for the view go to the current mode
+  void (*onKey)(struct View* view, int key, int mods);
+  void* user;
+} View;
+
+void error_callback(int error, const char* description);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void refresh_callback(GLFWwindow* window);
+
+// reset a view to the untransformed image
+void viewInit(View* view);
+// make a window report its input to view
+void attachView(GLFWwindow* window, View* view);
+
+// compose shear, zoom, translate and rotate from a view into m
+void viewTransform(View* view, mat4x4 m);
+
+#endif
@@ -0,0 +1,431 @@
+#include "filter.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//rows each thread takes at a time, at least this many and at least four radii so the rows read
+//twice above and below a band stay a small part of the work
+#define FILTER_BAND 128
+//pixels across that are filtered together, so the rows of a band being summed down stay in cache
+#define FILTER_BLOCK 256
+
+static const char* kindNames[FILTER_KINDS] = {"none", "blur", "sharpen", "edges"};
+
+static void stageDefaults(FilterStage* stage, int kind)
+{
+  stage->kind = kind;
+  stage->radius = kind == FILTER_BLUR ? 4 : kind == FILTER_SHARPEN ? 2 : 1;
+  stage->amount = 1.0f;
+}
+
+int filterParse(FilterChain* chain, const char* spec)
+{
+  char name[32];
+  const char* p = spec;
+
+  memset(chain, 0, sizeof(FilterChain));
+  while(*p) {
+    FilterStage* stage;
+    int len = (int)strcspn(p, ":,"), kind;
+
+    if(chain->count == FILTER_MAX_STAGES || len == 0 || len >= (int)sizeof(name)) return 0;
+    memcpy(name, p, len);
+    name[len] = '\0';
+    for(kind = 1; kind < FILTER_KINDS; kind++)
+      if(strcmp(name, kindNames[kind]) == 0) break;
+    if(kind == FILTER_KINDS) return 0;
+
+    stage = &chain->stage[chain->count++];
+    stageDefaults(stage, kind);
+    p += len;
+    if(*p == ':') {
+      char* end;
+      stage->radius = (int)strtol(p + 1, &end, 10);
+      if(end == p + 1 || stage->radius < 0 || stage->radius > FILTER_MAX_RADIUS) return 0;
+      p = end;
+    }
+    if(*p == ':') {
+      char* end;
+      stage->amount = strtof(p + 1, &end);
+      if(end == p + 1) return 0;
+      p = end;
+    }
+    if(*p == ',') p++;
+    else if(*p) return 0;
+  }
+  return chain->count > 0;
+}
+
+int filterActive(const FilterChain* chain)
+{
+  int i;
+  for(i = 0; i < chain->count; i++)
+    if(chain->stage[i].kind != FILTER_NONE) return 1;
+  return 0;
+}
+
+void filterDescribe(const FilterChain* chain, char* buf, size_t size)
+{
+  size_t used = 0;
+  int i;
+
+  buf[0] = '\0';
+  for(i = 0; i < chain->count && used < size; i++) {
+    const FilterStage* stage = &chain->stage[i];
+    if(stage->kind == FILTER_NONE) continue;
+    if(stage->kind == FILTER_SHARPEN && stage->amount != 1.0f)
+      used += snprintf(buf + used, size - used, "%s%s %d x%.2g", used ? ", " : "",
+                       kindNames[stage->kind], stage->radius, stage->amount);
+    else
+      used += snprintf(buf + used, size - used, "%s%s %d", used ? ", " : "",
+                       kindNames[stage->kind], stage->radius);
+  }
+  if(used == 0) snprintf(buf, size, "no filter");
+}
+
+void filterCycle(FilterChain* chain)
+{
+  FilterStage* stage;
+
+  if(chain->count == 0) chain->count = 1;
+  stage = &chain->stage[chain->count - 1];
+  //off stays in the chain so the next press starts over at blur
+  stageDefaults(stage, (stage->kind + 1) % FILTER_KINDS);
+  chain->generation++;
+}
+
+void filterAdjustRadius(FilterChain* chain, int delta)
+{
+  FilterStage* stage;
+  int radius;
+
+  if(chain->count == 0) return;
+  stage = &chain->stage[chain->count - 1];
+  radius = stage->radius + delta;
+  if(radius < 0) radius = 0;
+  if(radius > FILTER_MAX_RADIUS) radius = FILTER_MAX_RADIUS;
+  if(stage->kind == FILTER_NONE || radius == stage->radius) return;
+  stage->radius = radius;
+  chain->generation++;
+}
+
+//normalized gaussian in taps[0] to taps[2 * radius]. the radius is three sigma, a bit less for small ones
+static void gaussian(float* taps, int radius, float extent)
+{
+  float sigma = extent / 3.0f > 0.5f ? extent / 3.0f : 0.5f, sum = 0;
+  int k;
+
+  for(k = -radius; k <= radius; k++) {
+    taps[radius + k] = expf(-(float)(k * k) / (2 * sigma * sigma));
+    sum += taps[radius + k];
+  }
+  for(k = 0; k <= 2 * radius; k++)
+    taps[k] /= sum;
+}
+
+void filterKernel(FilterKernel* k, const FilterStage* stage, float scale)
+{
+  float extent = stage->radius / scale;
+  int radius = (int)ceilf(extent), i, j;
+
+  memset(k, 0, sizeof(FilterKernel));
+  if(radius > FILTER_MAX_RADIUS) radius = FILTER_MAX_RADIUS;
+  k->kind = stage->kind;
+  k->amount = stage->amount;
+
+  if(stage->kind != FILTER_EDGES) {
+    k->radius = radius;
+    gaussian(k->smooth, radius, extent);
+    return;
+  }
+
+  //sobel is [1 2 1] / 4 along one axis and [-1 0 1] / 2 along the other, widened by the gaussian
+  {
+    static const float sobelSmooth[3] = {0.25f, 0.5f, 0.25f};
+    static const float sobelDeriv[3] = {-0.5f, 0.0f, 0.5f};
+    float g[FILTER_MAX_TAPS];
+
+    gaussian(g, radius, extent);
+    k->radius = radius + 1;
+    for(i = 0; i <= 2 * radius; i++)
+      for(j = 0; j < 3; j++) {
+        k->smooth[i + j] += g[i] * sobelSmooth[j];
+        k->deriv[i + j] += g[i] * sobelDeriv[j];
+      }
+  }
+}
+
+//what one stage needs, shared by every thread running it
+typedef struct {
+  const unsigned char* src;
+  unsigned char* dst;
+  int width, height;
+  FilterKernel kernel;
+  int bandRows, bandCount;
+  int* failed;
+} FilterJob;
+
+//out[i] = sum of taps[radius + k] * in[i + k * step], for k from -radius to radius
+static void convolveLine(float* out, const float* in, int n, int step, const float* taps, int radius)
+{
+  int i = 0, k;
+
+#if defined(LINMATH_V4)
+  linmath_v4 w[FILTER_MAX_TAPS];
+  for(k = 0; k <= 2 * radius; k++)
+    w[k] = linmath_splat(taps[k]);
+  for(; i + 4 <= n; i += 4) {
+    const float* p = in + i - radius * step;
+    linmath_v4 acc = linmath_mul(w[0], linmath_load(p));
+    for(k = 1; k <= 2 * radius; k++)
+      acc = linmath_add(acc, linmath_mul(w[k], linmath_load(p + k * step)));
+    linmath_store(out + i, acc);
+  }
+#endif
+  for(; i < n; i++) {
+    const float* p = in + i - radius * step;
+    float acc = 0;
+    for(k = 0; k <= 2 * radius; k++)
+      acc += taps[k] * p[k * step];
+    out[i] = acc;
+  }
+}
+
+//out[i] = sum of taps[k] * rows[k][i], for the 2 * radius + 1 rows around the one being written
+static void convolveRows(float* out, const float* const* rows, int n, const float* taps, int radius)
+{
+  int i = 0, k;
+
+#if defined(LINMATH_V4)
+  linmath_v4 w[FILTER_MAX_TAPS];
+  for(k = 0; k <= 2 * radius; k++)
+    w[k] = linmath_splat(taps[k]);
+  for(; i + 4 <= n; i += 4) {
+    linmath_v4 acc = linmath_mul(w[0], linmath_load(rows[0] + i));
+    for(k = 1; k <= 2 * radius; k++)
+      acc = linmath_add(acc, linmath_mul(w[k], linmath_load(rows[k] + i)));
+    linmath_store(out + i, acc);
+  }
+#endif
+  for(; i < n; i++) {
+    float acc = 0;
+    for(k = 0; k <= 2 * radius; k++)
+      acc += taps[k] * rows[k][i];
+    out[i] = acc;
+  }
+}
+
+static inline unsigned char toByte(float v)
+{
+  v = v > 0.0f ? v : 0.0f;
+  v = v < 255.0f ? v : 255.0f;
+  return (unsigned char)(v + 0.5f);
+}
+
+//bytes to floats, 16 at a time where there are vector units
+static void widenBytes(float* out, const unsigned char* in, int n)
+{
+  int i = 0;
+
+#if defined(__SSE2__)
+  __m128i zero = _mm_setzero_si128();
+  for(; i + 16 <= n; i += 16) {
+    __m128i b = _mm_loadu_si128((const __m128i*)(in + i));
+    __m128i lo = _mm_unpacklo_epi8(b, zero), hi = _mm_unpackhi_epi8(b, zero);
+    _mm_storeu_ps(out + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+    _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+    _mm_storeu_ps(out + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+    _mm_storeu_ps(out + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+  }
+#elif defined(__ARM_NEON)
+  for(; i + 16 <= n; i += 16) {
+    uint8x16_t b = vld1q_u8(in + i);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(b)), hi = vmovl_u8(vget_high_u8(b));
+    vst1q_f32(out + i, vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))));
+    vst1q_f32(out + i + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))));
+    vst1q_f32(out + i + 8, vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))));
+    vst1q_f32(out + i + 12, vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))));
+  }
+#endif
+  for(; i < n; i++)
+    out[i] = in[i];
+}
+
+//floats back to bytes, clamped and rounded the way toByte does it
+static void narrowFloats(unsigned char* out, const float* in, int n)
+{
+  int i = 0;
+
+#if defined(__SSE2__)
+  __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+  for(; i + 16 <= n; i += 16) {
+    __m128i v[4];
+    int k;
+    for(k = 0; k < 4; k++) {
+      __m128 f = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + k * 4), lo), hi);
+      v[k] = _mm_cvttps_epi32(_mm_add_ps(f, half));
+    }
+    _mm_storeu_si128((__m128i*)(out + i),
+                     _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3])));
+  }
+#elif defined(__ARM_NEON)
+  float32x4_t lo = vdupq_n_f32(0.0f), hi = vdupq_n_f32(255.0f), half = vdupq_n_f32(0.5f);
+  for(; i + 8 <= n; i += 8) {
+    float32x4_t a = vminq_f32(vmaxq_f32(vld1q_f32(in + i), lo), hi);
+    float32x4_t b = vminq_f32(vmaxq_f32(vld1q_f32(in + i + 4), lo), hi);
+    uint16x8_t v = vcombine_u16(vmovn_u32(vcvtq_u32_f32(vaddq_f32(a, half))),
+                                vmovn_u32(vcvtq_u32_f32(vaddq_f32(b, half))));
+    vst1_u8(out + i, vmovn_u16(v));
+  }
+#endif
+  for(; i < n; i++)
+    out[i] = toByte(in[i]);
+}
+
+//filter the rows of one band, a block of columns at a time. each block is convolved across into
+//scratch rows, with the rows above and below the band that the pass down reads, then summed down
+static void filterBand(const void* arg, int band)
+{
+  const FilterJob* job = arg;
+  const FilterKernel* kern = &job->kernel;
+  int r = kern->radius, w = job->width, h = job->height;
+  int y0 = band * job->bandRows, y1 = y0 + job->bandRows < h ? y0 + job->bandRows : h;
+  int rows = y1 - y0 + 2 * r, edges = kern->kind == FILTER_EDGES, channels = edges ? 1 : 3;
+  //edges keep the smoothed and differentiated luminance side by side in each scratch row
+  int span = FILTER_BLOCK * 3;
+  float* line = malloc(sizeof(float) * (FILTER_BLOCK + 2 * r) * channels);
+  float* across = malloc(sizeof(float) * span * rows);
+  float* down = malloc(sizeof(float) * span);
+  const float** smoothRows = malloc(sizeof(float*) * (2 * r + 1));
+  const float** derivRows = malloc(sizeof(float*) * (2 * r + 1));
+  int x0, x, y, j, k, c;
+
+  if(!line || !across || !down || !smoothRows || !derivRows) {
+    *job->failed = 1;
+    goto done;
+  }
+
+  for(x0 = 0; x0 < w; x0 += FILTER_BLOCK) {
+    int n = w - x0 < FILTER_BLOCK ? w - x0 : FILTER_BLOCK;
+    //part of the widened line that is inside the image
+    int inStart = x0 < r ? r - x0 : 0, inEnd = x0 + n + r < w ? n + 2 * r : w - x0 + r;
+
+    for(j = 0; j < rows; j++) {
+      int sy = y0 - r + j;
+      const unsigned char* row = job->src + (size_t)(sy < 0 ? 0 : sy >= h ? h - 1 : sy) * w * 3;
+      float* out = across + (size_t)j * span;
+
+      //widen to float with the edge pixels repeated past either side. only the ends need clamping
+      if(!edges)
+        widenBytes(line + inStart * 3, row + (x0 - r + inStart) * 3, (inEnd - inStart) * 3);
+      for(k = 0; k < n + 2 * r; k++) {
+        const unsigned char* px;
+        int sx;
+        if(!edges && k == inStart) k = inEnd;
+        if(k == n + 2 * r) break;
+        sx = x0 - r + k;
+        px = row + (sx < 0 ? 0 : sx >= w ? w - 1 : sx) * 3;
+        if(edges) {
+          line[k] = 0.299f * px[0] + 0.587f * px[1] + 0.114f * px[2];
+        } else {
+          line[k * 3] = px[0];
+          line[k * 3 + 1] = px[1];
+          line[k * 3 + 2] = px[2];
+        }
+      }
+      if(edges) {
+        convolveLine(out, line + r, n, 1, kern->smooth, r);
+        convolveLine(out + FILTER_BLOCK, line + r, n, 1, kern->deriv, r);
+      } else {
+        convolveLine(out, line + r * 3, n * 3, 3, kern->smooth, r);
+      }
+    }
+
+    for(y = y0; y < y1; y++) {
+      unsigned char* dst = job->dst + ((size_t)y * w + x0) * 3;
+
+      for(k = 0; k <= 2 * r; k++) {
+        smoothRows[k] = across + (size_t)(y - y0 + k) * span;
+        derivRows[k] = smoothRows[k] + FILTER_BLOCK;
+      }
+
+      if(edges) {
+        //x gradient is the difference across smoothed down, y the other way round
+        convolveRows(down, derivRows, n, kern->smooth, r);
+        convolveRows(down + FILTER_BLOCK, smoothRows, n, kern->deriv, r);
+        for(x = 0; x < n; x++) {
+          unsigned char g = toByte(2 * sqrtf(down[x] * down[x] + down[FILTER_BLOCK + x] * down[FILTER_BLOCK + x]));
+          dst[x * 3] = dst[x * 3 + 1] = dst[x * 3 + 2] = g;
+        }
+      } else if(kern->kind == FILTER_SHARPEN) {
+        //the line is free again by now, use it for the unfiltered pixels
+        widenBytes(line, job->src + ((size_t)y * w + x0) * 3, n * 3);
+        convolveRows(down, smoothRows, n * 3, kern->smooth, r);
+        for(c = 0; c < n * 3; c++)
+          down[c] = line[c] + kern->amount * (line[c] - down[c]);
+        narrowFloats(dst, down, n * 3);
+      } else {
+        convolveRows(down, smoothRows, n * 3, kern->smooth, r);
+        narrowFloats(dst, down, n * 3);
+      }
+    }
+  }
+
+done:
+  free(derivRows);
+  free(smoothRows);
+  free(down);
+  free(across);
+  free(line);
+}
+
+int filterImage(unsigned char* dst, const unsigned char* src, int width, int height,
+                const FilterChain* chain, SoftRenderer* r)
+{
+  const FilterStage* active[FILTER_MAX_STAGES];
+  unsigned char* scratch = NULL;
+  const unsigned char* in = src;
+  MemBlock block = {0};
+  int count = 0, failed = 0, i;
+
+  for(i = 0; i < chain->count; i++)
+    if(chain->stage[i].kind != FILTER_NONE) active[count++] = &chain->stage[i];
+  if(count == 0) {
+    memcpy(dst, src, (size_t)width * height * 3);
+    return 1;
+  }
+
+  //stages alternate between dst and a scratch image, arranged so the last one lands in dst
+  if(count > 1) {
+    scratch = malloc((size_t)width * height * 3);
+    if(scratch == NULL) return 0;
+    memTrack(&block, MEM_CPU, "filter scratch", (size_t)width * height * 3, NULL, NULL);
+  }
+
+  for(i = 0; i < count && !failed; i++) {
+    FilterJob job;
+
+    filterKernel(&job.kernel, active[i], 1.0f);
+    job.src = in;
+    job.dst = (count - 1 - i) % 2 == 0 ? dst : scratch;
+    job.width = width;
+    job.height = height;
+    job.bandRows = 4 * job.kernel.radius > FILTER_BAND ? 4 * job.kernel.radius : FILTER_BAND;
+    job.bandCount = (height + job.bandRows - 1) / job.bandRows;
+    job.failed = &failed;
+    softRunTiles(r, job.bandCount, filterBand, &job);
+    in = job.dst;
+  }
+
+  memUntrack(&block);
+  free(scratch);
+  return !failed;
+}
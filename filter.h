@@ -0,0 +1,63 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stddef.h>
+
+#include "softrender.h"
+
+//largest radius a stage can be given, in pixels of the full size image
+#define FILTER_MAX_RADIUS 32
+//taps in the longest 1D kernel, 2 * (FILTER_MAX_RADIUS + 1) + 1 since edges widen by one
+#define FILTER_MAX_TAPS 67
+#define FILTER_MAX_STAGES 4
+
+enum {
+  FILTER_NONE = 0,
+  FILTER_BLUR,          //gaussian
+  FILTER_SHARPEN,       //unsharp mask, the image plus amount times what the blur took away
+  FILTER_EDGES,         //sobel gradient magnitude of the luminance, smoothed first for radius > 0
+  FILTER_KINDS
+};
+
+typedef struct {
+  int kind;
+  int radius;
+  float amount;
+} FilterStage;
+
+//stages applied one after another. generation changes whenever a stage does, so views know to redo it
+typedef struct {
+  int count;
+  FilterStage stage[FILTER_MAX_STAGES];
+  int generation;
+} FilterChain;
+
+//the two 1D kernels a stage is split into, tap k of either at index radius + k
+typedef struct {
+  int kind;
+  int radius;
+  float amount;
+  float smooth[FILTER_MAX_TAPS];
+  float deriv[FILTER_MAX_TAPS];     //only used by edges
+} FilterKernel;
+
+// read stages from e.g. "blur:4,sharpen:2:1.5,edges". returns 0 on a bad spec
+int filterParse(FilterChain* chain, const char* spec);
+// 1 if any stage changes the image
+int filterActive(const FilterChain* chain);
+// e.g. "blur 4, edges 1" for window titles
+void filterDescribe(const FilterChain* chain, char* buf, size_t size);
+// step the last stage through blur, sharpen, edges and off
+void filterCycle(FilterChain* chain);
+// grow or shrink the radius of the last stage
+void filterAdjustRadius(FilterChain* chain, int delta);
+
+// kernels for a stage run on an image scaled down by scale from the full size one
+void filterKernel(FilterKernel* k, const FilterStage* stage, float scale);
+
+// run the chain over an 8 bit RGB image on the renderer's threads. dst and src must not overlap.
+// returns 0 if out of memory
+int filterImage(unsigned char* dst, const unsigned char* src, int width, int height,
+                const FilterChain* chain, SoftRenderer* r);
+
+#endif
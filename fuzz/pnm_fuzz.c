@@ -0,0 +1,30 @@
+// libFuzzer target for the PNM header parser and the conversion of the pixels behind it.
+//
+// Build and run with make fuzz, or by hand: ./pnm-fuzz new-inputs/ fuzz/corpus/
+
+#include "../pnm.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  PnmHeader hdr;
+  unsigned char* rgb;
+  size_t rows;
+
+  if(pnmParseHeader(data, size, &hdr) != PNM_OK) return 0;
+
+  //convert the whole rows the input holds, as the viewer would for a truncated file. each row takes
+  //at least one byte per pixel, so the output is never more than three times the input
+  if(hdr.offset > size) __builtin_trap();
+  rows = (size - hdr.offset) / hdr.rowBytes;
+  if(rows > hdr.height) rows = hdr.height;
+  if(rows == 0) return 0;
+
+  rgb = malloc((size_t)hdr.width * 3 * rows);
+  if(rgb == NULL) return 0;
+  pnmToRgb8(rgb, data + hdr.offset, &hdr, rows);
+  free(rgb);
+  return 0;
+}
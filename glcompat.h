@@ -0,0 +1,18 @@
+#ifndef GLCOMPAT_H
+#define GLCOMPAT_H
+
+//macOS keeps GL in a framework, elsewhere everything past GL 1.1 is declared by the extension header
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+// whether the current context has an extension, and where one of its entry points is. the viewer
+// answers these through GLFW, the benchmarks through EGL
+int glHasExtension(const char* name);
+void* glProcAddress(const char* name);
+
+#endif
@@ -0,0 +1,224 @@
+#include "glfilter.h"
+#include "imageprog.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//the pass covers the target exactly, so each fragment reads the source texel under it
+static const char* pass_vertex_text =
+"attribute vec2 vPos;\n"
+"varying vec2 TexCoord;\n"
+"void main()\n"
+"{\n"
+"    gl_Position = vec4(vPos, 0.0, 1.0);\n"
+"    TexCoord = vPos * 0.5 + 0.5;\n"
+"}\n";
+
+//one 1D pass. A and B are two kernels run over the same taps, Luma turns the taps grey first, and
+//Mode picks what is written: 0 the A sum, 1 unsharp mask of Original by it, 2 the A and B sums of
+//the luminance for the edge pass down, 3 the gradient magnitude from those.
+//the -8 bias keeps mipmapped sources on level 0, and the arrays are FILTER_MAX_TAPS long
+static const char* pass_fragment_text =
+"uniform sampler2D Source;\n"
+"uniform sampler2D Original;\n"
+"uniform vec2 Step;\n"
+"uniform int Taps;\n"
+"uniform float Luma;\n"
+"uniform int Mode;\n"
+"uniform float Amount;\n"
+"uniform float WeightsA[67];\n"
+"uniform float WeightsB[67];\n"
+"varying vec2 TexCoord;\n"
+"void main()\n"
+"{\n"
+"    vec4 a = vec4(0.0), b = vec4(0.0);\n"
+"    vec2 at = TexCoord - float(Taps / 2) * Step;\n"
+"    for(int i = 0; i < Taps; i++) {\n"
+"        vec4 t = texture2D(Source, at, -8.0);\n"
+"        t = mix(t, vec4(dot(t.rgb, vec3(0.299, 0.587, 0.114))), Luma);\n"
+"        a += WeightsA[i] * t;\n"
+"        b += WeightsB[i] * t;\n"
+"        at += Step;\n"
+"    }\n"
+"    if(Mode == 1) {\n"
+"        vec3 o = texture2D(Original, TexCoord, -8.0).rgb;\n"
+"        gl_FragColor = vec4(o + Amount * (o - a.rgb), 1.0);\n"
+"    } else if(Mode == 2) {\n"
+"        gl_FragColor = vec4(a.r, b.r * 0.5 + 0.5, 0.0, 1.0);\n"
+"    } else if(Mode == 3) {\n"
+"        float g = 2.0 * length(vec2(a.g * 2.0 - 1.0, b.r));\n"
+"        gl_FragColor = vec4(g, g, g, 1.0);\n"
+"    } else {\n"
+"        gl_FragColor = vec4(a.rgb, 1.0);\n"
+"    }\n"
+"}\n";
+
+static size_t filterBytes(const GlFilter* f)
+{
+  size_t texels = (size_t)f->width * f->height, bytes = 0;
+
+  if(f->across) bytes += texels * 8;
+  if(f->output[0]) bytes += texels * 4 * 4 / 3;
+  if(f->output[1]) bytes += texels * 4 * 4 / 3;
+  return bytes;
+}
+
+//the result is on screen, the 16 bit texture and the other output are only needed to run again
+static int dropFilterScratch(MemBlock* block)
+{
+  GlFilter* f = block->user;
+  int other = 1 - f->result;
+
+  if(!f->across && !f->output[other]) return 0;
+  glDeleteTextures(1, &f->across);
+  f->across = 0;
+  if(f->output[other]) {
+    glDeleteTextures(1, &f->output[other]);
+    f->output[other] = 0;
+  }
+  memResize(block, filterBytes(f));
+  return 1;
+}
+
+static void freeTextures(GlFilter* f)
+{
+  if(f->across) glDeleteTextures(1, &f->across);
+  if(f->output[0]) glDeleteTextures(1, &f->output[0]);
+  if(f->output[1]) glDeleteTextures(1, &f->output[1]);
+  f->across = f->output[0] = f->output[1] = 0;
+}
+
+static GLuint createTexture(GLenum internalFormat, int width, int height)
+{
+  GLuint tex;
+
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  return tex;
+}
+
+int glFilterInit(GlFilter* f)
+{
+  memset(f, 0, sizeof(GlFilter));
+  if(!glHasExtension("GL_ARB_framebuffer_object")) {
+    fprintf(stderr, "Unable to filter on the GPU: no framebuffer objects\n");
+    return 0;
+  }
+
+  f->program = linkProgram(pass_vertex_text, pass_fragment_text, NULL);
+  f->vposLocation = glGetAttribLocation(f->program, "vPos");
+  f->sourceLocation = glGetUniformLocation(f->program, "Source");
+  f->originalLocation = glGetUniformLocation(f->program, "Original");
+  f->stepLocation = glGetUniformLocation(f->program, "Step");
+  f->tapsLocation = glGetUniformLocation(f->program, "Taps");
+  f->lumaLocation = glGetUniformLocation(f->program, "Luma");
+  f->modeLocation = glGetUniformLocation(f->program, "Mode");
+  f->amountLocation = glGetUniformLocation(f->program, "Amount");
+  f->weightsALocation = glGetUniformLocation(f->program, "WeightsA");
+  f->weightsBLocation = glGetUniformLocation(f->program, "WeightsB");
+  glGenFramebuffers(1, &f->fbo);
+  return 1;
+}
+
+void glFilterFree(GlFilter* f)
+{
+  memUntrack(&f->block);
+  freeTextures(f);
+  if(f->fbo) glDeleteFramebuffers(1, &f->fbo);
+  if(f->program) glDeleteProgram(f->program);
+  memset(f, 0, sizeof(GlFilter));
+}
+
+//draw the quad into level 0 of target
+static int drawPass(GlFilter* f, GLuint target)
+{
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+  if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "Unable to filter on the GPU: can't draw into a %dx%d texture\n", f->width, f->height);
+    return 0;
+  }
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+  return 1;
+}
+
+int glFilterRun(GlFilter* f, const FilterChain* chain, GLuint source, int width, int height, float scale)
+{
+  GLuint in = source;
+  int i, ok = 1, out = -1;
+
+  //a new size needs new textures, everything else reuses what the last run made
+  if(width != f->width || height != f->height) {
+    freeTextures(f);
+    f->width = width;
+    f->height = height;
+  }
+  if(!f->across)
+    f->across = createTexture(GL_RGBA16, width, height);
+
+  glUseProgram(f->program);
+  glBindFramebuffer(GL_FRAMEBUFFER, f->fbo);
+  glViewport(0, 0, width, height);
+  glEnableVertexAttribArray(f->vposLocation);
+  glVertexAttribPointer(f->vposLocation, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+  glUniform1i(f->sourceLocation, 0);
+  glUniform1i(f->originalLocation, 1);
+
+  for(i = 0; i < chain->count && ok; i++) {
+    const FilterStage* stage = &chain->stage[i];
+    FilterKernel k;
+    int edges = stage->kind == FILTER_EDGES;
+
+    if(stage->kind == FILTER_NONE) continue;
+    filterKernel(&k, stage, scale);
+    out = out == 0 ? 1 : 0;
+    if(!f->output[out]) {
+      f->output[out] = createTexture(GL_RGBA8, width, height);
+      samplingInit(&f->sampling[out]);
+    }
+
+    glUniform1i(f->tapsLocation, 2 * k.radius + 1);
+    glUniform1f(f->amountLocation, k.amount);
+    glUniform1fv(f->weightsALocation, FILTER_MAX_TAPS, k.smooth);
+    glUniform1fv(f->weightsBLocation, FILTER_MAX_TAPS, k.deriv);
+
+    //across the rows into the 16 bit texture, so the second pass doesn't sum rounded values
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, in);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, in);
+    glUniform2f(f->stepLocation, 1.0f / width, 0.0f);
+    glUniform1f(f->lumaLocation, edges ? 1.0f : 0.0f);
+    glUniform1i(f->modeLocation, edges ? 2 : 0);
+    ok = drawPass(f, f->across);
+
+    //then down the columns into this stage's output
+    glBindTexture(GL_TEXTURE_2D, f->across);
+    glUniform2f(f->stepLocation, 0.0f, 1.0f / height);
+    glUniform1f(f->lumaLocation, 0.0f);
+    glUniform1i(f->modeLocation, edges ? 3 : stage->kind == FILTER_SHARPEN ? 1 : 0);
+    ok = ok && drawPass(f, f->output[out]);
+
+    //the next stage reads level 0, but the last one is drawn zoomed and needs the rest
+    glBindTexture(GL_TEXTURE_2D, f->output[out]);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    in = f->output[out];
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDisableVertexAttribArray(f->vposLocation);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+
+  if(!f->block.tracked) memTrack(&f->block, MEM_GPU, "filter textures", filterBytes(f), dropFilterScratch, f);
+  else memResize(&f->block, filterBytes(f));
+  if(!ok || out < 0) return 0;
+  f->result = out;
+  return 1;
+}
@@ -0,0 +1,36 @@
+#ifndef GLFILTER_H
+#define GLFILTER_H
+
+#include "glcompat.h"
+
+#include "filter.h"
+#include "sampling.h"
+#include "budget.h"
+
+//runs a filter chain on the GPU. every stage is a pass across the rows into a 16 bit texture and a
+//pass down the columns into one of two outputs, which take turns being read and written
+typedef struct {
+  GLuint program;
+  GLint vposLocation, sourceLocation, originalLocation, stepLocation, tapsLocation;
+  GLint lumaLocation, modeLocation, amountLocation, weightsALocation, weightsBLocation;
+
+  GLuint fbo;
+  GLuint across;            //RGBA16, kept between runs so adjusting a radius doesn't reallocate
+  GLuint output[2];         //RGBA8 with mipmaps, 0 until a chain needs it
+  Sampling sampling[2];
+  int width, height;        //size the textures were made for
+  int result;               //output holding the last run
+
+  MemBlock block;
+} GlFilter;
+
+// build the filter program, needs a current context. returns 0 if framebuffer objects are missing
+int glFilterInit(GlFilter* f);
+void glFilterFree(GlFilter* f);
+// filter level 0 of source, a width x height texture that is scale times smaller than the full
+// image, into f->output[f->result]. the image quad's buffers must be bound. the default framebuffer
+// is bound again after, but the viewport, program and vertex attributes are left changed.
+// returns 0 on failure
+int glFilterRun(GlFilter* f, const FilterChain* chain, GLuint source, int width, int height, float scale);
+
+#endif
@@ -0,0 +1,183 @@
+#include "imageprog.h"
+#include "progcache.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+// (-1, 1)  (1, 1)
+// (-1, -1) (1, -1)
+//Define the vertexes for the rectangle being drawn on
+Vertex vertexes[] = {
+  {{1, -1},  {0.99999, 0.99999}},
+  {{1, 1}, {0.99999, 0}},
+  {{-1, -1}, {0, 0.99999}},
+  {{-1, 1}, {0, 0}}
+};
+//Define the two triangles of the square
+GLuint indices[] = {
+    0, 1, 3,   // First Triangle
+    2, 0, 3     // Second Triangle
+};
+
+
+//vertex shader code
+static const char* vertex_shader_text =
+"uniform mat4 MVP;\n"
+"attribute vec2 TexCoordIn;\n"
+"attribute vec2 vPos;\n"
+"varying vec2 TexCoordOut;\n"
+"void main()\n"
+"{\n"
+"    gl_Position = MVP * vec4(vPos, 0.0, 1.0);\n"
+"    TexCoordOut = TexCoordIn;\n"
+"}\n";
+
+//fragment shader code
+static const char* fragment_shader_text =
+"varying vec2 TexCoordOut;\n"
+"uniform sampler2D Texture;\n"
+"void main()\n"
+"{\n"
+"    gl_FragColor = texture2D(Texture, TexCoordOut);\n"
+"}\n";
+
+// Program to handle the compiling of the shader, and upon failure the calling of an error and exit of the program
+void glCompileShaderOrDie(GLuint shader) {
+  GLint compiled;
+  glCompileShader(shader);
+  glGetShaderiv(shader,
+		GL_COMPILE_STATUS,
+		&compiled);
+  if (!compiled) {
+    GLint infoLen = 0;
+    glGetShaderiv(shader,
+		  GL_INFO_LOG_LENGTH,
+		  &infoLen);
+    char* info = malloc(infoLen+1);
+    GLint done;
+    glGetShaderInfoLog(shader, infoLen, &done, info);
+    printf("Unable to compile shader: %s\n", info);
+    exit(1);
+  }
+}
+
+// Program to handle the linking of the program, and upon failure the calling of an error and exit of the program
+void glLinkProgramOrDie(GLuint program) {
+  GLint linked;
+  glLinkProgram(program);
+  glGetProgramiv(program,
+		GL_LINK_STATUS,
+		&linked);
+  if (!linked) {
+    GLint infoLen = 0;
+    glGetProgramiv(program,
+		  GL_INFO_LOG_LENGTH,
+		  &infoLen);
+    char* info = malloc(infoLen+1);
+    GLint done;
+    glGetProgramInfoLog(program, infoLen, &done, info);
+    printf("Unable to link program: %s\n", info);
+    exit(1);
+  }
+}
+
+// find the uniforms and attributes in a linked image program and make it current
+static void lookUpLocations(ImageProgram* prog) {
+  //set the mvp location from the vertex shader
+  prog->mvp_location = glGetUniformLocation(prog->program, "MVP");
+  assert(prog->mvp_location != -1);
+
+  //set the vpos location from the vertex shader
+  prog->vpos_location = glGetAttribLocation(prog->program, "vPos");
+  assert(prog->vpos_location != -1);
+  //set the texture coordinate location from the fragment shader
+  prog->texcoord_location = glGetAttribLocation(prog->program, "TexCoordIn");
+  assert(prog->texcoord_location != -1);
+  //set the texture location from the fragment shader
+  prog->tex_location = glGetUniformLocation(prog->program, "Texture");
+  assert(prog->tex_location != -1);
+
+  glUseProgram(prog->program);
+}
+
+// compile and link a program from its shader sources, or load it from the program cache
+GLuint linkProgram(const char* vertexText, const char* fragmentText, int* cached) {
+  GLuint vertex_shader, fragment_shader, program;
+
+  //a program linked by an earlier run on this driver skips compiling entirely
+  program = progCacheLoad(vertexText, fragmentText);
+  if(cached) *cached = program != 0;
+  if(program)
+    return program;
+
+  //initialize the vertex shader
+  vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+  glShaderSource(vertex_shader, 1, &vertexText, NULL);
+  glCompileShaderOrDie(vertex_shader);
+
+  //initialize the fragment shader
+  fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(fragment_shader, 1, &fragmentText, NULL);
+  glCompileShaderOrDie(fragment_shader);
+
+  // Create the program
+  program = glCreateProgram();
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  progCacheHint(program);
+  glLinkProgramOrDie(program);
+  //the program keeps what it needs from the shaders
+  glDetachShader(program, vertex_shader);
+  glDetachShader(program, fragment_shader);
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+
+  progCacheStore(program, vertexText, fragmentText);
+  return program;
+}
+
+// build the image shader program and look up everything the draw calls need from it.
+// returns 1 if the linked program came from the cache
+int createImageProgram(ImageProgram* prog) {
+  int cached;
+
+  prog->program = linkProgram(vertex_shader_text, fragment_shader_text, &cached);
+  lookUpLocations(prog);
+  return cached;
+}
+
+// upload the rectangle the image is drawn on and leave its buffers bound
+void createImageQuad(GLuint* vertex_buffer, GLuint* EBO) {
+  //set up the element buffer object
+  glGenBuffers(1, EBO);
+
+  glGenBuffers(1, vertex_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, *vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertexes), vertexes, GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *EBO);
+  //element buffer object used for indeces
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+  sizeof(indices), indices, GL_STATIC_DRAW);
+}
+
+// point the position and texture coordinate attributes at the bound vertex buffer
+void bindVertexLayout(ImageProgram* prog) {
+  glEnableVertexAttribArray(prog->vpos_location);
+  glVertexAttribPointer(prog->vpos_location,
+			  2,
+			  GL_FLOAT,
+			  GL_FALSE,
+                          sizeof(Vertex),
+			  (void*) 0);
+
+  glEnableVertexAttribArray(prog->texcoord_location);
+  glVertexAttribPointer(prog->texcoord_location,
+			  2,
+			  GL_FLOAT,
+			  GL_FALSE,
+                          sizeof(Vertex),
+			  (void*) (sizeof(float) * 2));
+}
+
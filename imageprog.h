@@ -0,0 +1,32 @@
+#ifndef IMAGEPROG_H
+#define IMAGEPROG_H
+
+#include "glcompat.h"
+
+//layout of a single vertex handed to the image shader
+typedef struct {
+  float Position[2];
+  float TexCoord[2];
+} Vertex;
+
+//compiled image shader together with the locations looked up from it
+typedef struct {
+  GLuint program;
+  GLint mvp_location;
+  GLint vpos_location;
+  GLint texcoord_location;
+  GLint tex_location;
+} ImageProgram;
+
+// compile and link a program, or load it from the program cache. exits on failure, and sets
+// *cached, if given, to whether the cache was used
+GLuint linkProgram(const char* vertexText, const char* fragmentText, int* cached);
+// build and link the image shader, or load it from the program cache. exits on failure,
+// returns 1 if the cached program was used
+int createImageProgram(ImageProgram* prog);
+// create the buffers for the rectangle the image is drawn on, and leave them bound
+void createImageQuad(GLuint* vertex_buffer, GLuint* EBO);
+// point the vertex attributes of the image shader at the currently bound array buffer
+void bindVertexLayout(ImageProgram* prog);
+
+#endif
@@ -0,0 +1,77 @@
+#include "imagewindow.h"
+
+#include <stdlib.h>
+
+void imageWindowOpen(ImageWindow* iw, int width, int height, const char* title, int swapInterval)
+{
+  glfwSetErrorCallback(error_callback);
+  if (!glfwInit())
+    exit(EXIT_FAILURE);
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+
+  iw->window = glfwCreateWindow(width, height, title, NULL, NULL);
+  if (!iw->window)
+  {
+    glfwTerminate();
+    exit(EXIT_FAILURE);
+  }
+  viewInit(&iw->view);
+  attachView(iw->window, &iw->view);
+  glfwMakeContextCurrent(iw->window);
+  glfwSwapInterval(swapInterval);
+
+  createImageQuad(&iw->vertex_buffer, &iw->EBO);
+  createImageProgram(&iw->prog);
+  bindVertexLayout(&iw->prog);
+
+  glGenTextures(1, &iw->texID);
+  glBindTexture(GL_TEXTURE_2D, iw->texID);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glActiveTexture(GL_TEXTURE0);
+  glUseProgram(iw->prog.program);
+  glUniform1i(iw->prog.tex_location, 0);
+  samplingInit(&iw->sampling);
+}
+
+void imageWindowClose(ImageWindow* iw)
+{
+  glfwDestroyWindow(iw->window);
+  glfwTerminate();
+}
+
+void drawImageView(GLFWwindow* window, View* view, ImageProgram* prog, Sampling* sampling, GLuint texID,
+                   int texWidth, int texHeight)
+{
+  int width, height;
+  mat4x4 m, p, mvp;
+
+  glfwMakeContextCurrent(window);
+  glfwGetFramebufferSize(window, &width, &height);
+
+  glViewport(0, 0, width, height);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  viewTransform(view, m);
+
+  //texture parameters are shared between contexts, rebinding makes other contexts' changes visible
+  glBindTexture(GL_TEXTURE_2D, texID);
+  //minification quality follows the zoom level and whether the image is sheared
+  sampling->quality = view->sampleQuality;
+  samplingUpdate(sampling, samplingFootprint(texWidth, texHeight, width, height, view->scale), view->shear);
+
+  mat4x4_identity(p);
+  //apply all transformations
+  mat4x4_mul(mvp, p, m);
+
+  glUseProgram(prog->program);
+  glUniformMatrix4fv(prog->mvp_location, 1, GL_FALSE, (const GLfloat*) mvp);
+  //draw the updated geometry to the screen
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+  glfwSwapBuffers(window);
+}
@@ -0,0 +1,27 @@
+#ifndef IMAGEWINDOW_H
+#define IMAGEWINDOW_H
+
+#include "ezview.h"
+#include "sampling.h"
+
+//a window that shows one texture on the image quad, as the stream, sequence and shm viewers use
+typedef struct {
+  GLFWwindow* window;
+  View view;                //input goes here, so the struct must stay put once opened
+  ImageProgram prog;
+  GLuint vertex_buffer, EBO, texID;
+  Sampling sampling;
+} ImageWindow;
+
+// start glfw and open a width x height window with the quad, the image program and a texture with
+// no storage yet bound to unit 0. exits on failure
+void imageWindowOpen(ImageWindow* iw, int width, int height, const char* title, int swapInterval);
+// destroy the window and shut glfw down
+void imageWindowClose(ImageWindow* iw);
+
+// draw texID into window with view and swap. texWidth and texHeight are the size of the texture's
+// base level, which the LOD bias is worked out from
+void drawImageView(GLFWwindow* window, View* view, ImageProgram* prog, Sampling* sampling, GLuint texID,
+                   int texWidth, int texHeight);
+
+#endif
@@ -7,6 +7,36 @@
 #define inline __inline
 #endif
 
+/* Define LINMATH_SIMD to replace the hot mat4x4/vec4/quat routines with
+ * SSE or NEON versions. The API is the same either way; anything without
+ * a vector version keeps the plain C one. */
+#if defined(LINMATH_SIMD)
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LINMATH_SSE
+typedef __m128 linmath_v4;
+#define linmath_load(p)     _mm_loadu_ps(p)
+#define linmath_store(p, v) _mm_storeu_ps(p, v)
+#define linmath_splat(s)    _mm_set1_ps(s)
+#define linmath_add(a, b)   _mm_add_ps(a, b)
+#define linmath_sub(a, b)   _mm_sub_ps(a, b)
+#define linmath_mul(a, b)   _mm_mul_ps(a, b)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LINMATH_NEON
+typedef float32x4_t linmath_v4;
+#define linmath_load(p)     vld1q_f32(p)
+#define linmath_store(p, v) vst1q_f32(p, v)
+#define linmath_splat(s)    vdupq_n_f32(s)
+#define linmath_add(a, b)   vaddq_f32(a, b)
+#define linmath_sub(a, b)   vsubq_f32(a, b)
+#define linmath_mul(a, b)   vmulq_f32(a, b)
+#endif
+#if defined(LINMATH_SSE) || defined(LINMATH_NEON)
+#define LINMATH_V4
+#endif
+#endif
+
 #define LINMATH_H_DEFINE_VEC(n) \
 typedef float vec##n[n]; \
 static inline void vec##n##_add(vec##n r, vec##n const a, vec##n const b) \
@@ -114,24 +144,52 @@ static inline void mat4x4_transpose(mat4x4 M, mat4x4 N)
 		for(i=0; i<4; ++i)
 			M[i][j] = N[j][i];
 }
+#if defined(LINMATH_V4)
+static inline void mat4x4_add(mat4x4 M, mat4x4 a, mat4x4 b)
+{
+	int i;
+	for(i=0; i<4; ++i)
+		linmath_store(M[i], linmath_add(linmath_load(a[i]), linmath_load(b[i])));
+}
+#else
 static inline void mat4x4_add(mat4x4 M, mat4x4 a, mat4x4 b)
 {
 	int i;
 	for(i=0; i<4; ++i)
 		vec4_add(M[i], a[i], b[i]);
 }
+#endif
+#if defined(LINMATH_V4)
+static inline void mat4x4_sub(mat4x4 M, mat4x4 a, mat4x4 b)
+{
+	int i;
+	for(i=0; i<4; ++i)
+		linmath_store(M[i], linmath_sub(linmath_load(a[i]), linmath_load(b[i])));
+}
+#else
 static inline void mat4x4_sub(mat4x4 M, mat4x4 a, mat4x4 b)
 {
 	int i;
 	for(i=0; i<4; ++i)
 		vec4_sub(M[i], a[i], b[i]);
 }
+#endif
+#if defined(LINMATH_V4)
+static inline void mat4x4_scale(mat4x4 M, mat4x4 a, float k)
+{
+	linmath_v4 s = linmath_splat(k);
+	int i;
+	for(i=0; i<4; ++i)
+		linmath_store(M[i], linmath_mul(linmath_load(a[i]), s));
+}
+#else
 static inline void mat4x4_scale(mat4x4 M, mat4x4 a, float k)
 {
 	int i;
 	for(i=0; i<4; ++i)
 		vec4_scale(M[i], a[i], k);
 }
+#endif
 static inline void mat4x4_scale_aniso(mat4x4 M, mat4x4 a, float x, float y, float z)
 {
 	int i;
@@ -142,6 +200,26 @@ static inline void mat4x4_scale_aniso(mat4x4 M, mat4x4 a, float x, float y, floa
 		M[3][i] = a[3][i];
 	}
 }
+#if defined(LINMATH_V4)
+static inline void mat4x4_mul(mat4x4 M, mat4x4 a, mat4x4 b)
+{
+	/* Column c of the product is a's columns weighted by column c of b.
+	 * All of a and b are loaded up front, so M may alias either. */
+	linmath_v4 a0 = linmath_load(a[0]), a1 = linmath_load(a[1]);
+	linmath_v4 a2 = linmath_load(a[2]), a3 = linmath_load(a[3]);
+	float bc[4][4];
+	linmath_v4 r[4];
+	int c;
+	for(c=0; c<4; ++c)
+		linmath_store(bc[c], linmath_load(b[c]));
+	for(c=0; c<4; ++c)
+		r[c] = linmath_add(
+			linmath_add(linmath_mul(a0, linmath_splat(bc[c][0])), linmath_mul(a1, linmath_splat(bc[c][1]))),
+			linmath_add(linmath_mul(a2, linmath_splat(bc[c][2])), linmath_mul(a3, linmath_splat(bc[c][3]))));
+	for(c=0; c<4; ++c)
+		linmath_store(M[c], r[c]);
+}
+#else
 static inline void mat4x4_mul(mat4x4 M, mat4x4 a, mat4x4 b)
 {
 	mat4x4 temp;
@@ -153,6 +231,16 @@ static inline void mat4x4_mul(mat4x4 M, mat4x4 a, mat4x4 b)
 	}
 	mat4x4_dup(M, temp);
 }
+#endif
+#if defined(LINMATH_V4)
+static inline void mat4x4_mul_vec4(vec4 r, mat4x4 M, vec4 v)
+{
+	linmath_v4 t = linmath_add(
+		linmath_add(linmath_mul(linmath_load(M[0]), linmath_splat(v[0])), linmath_mul(linmath_load(M[1]), linmath_splat(v[1]))),
+		linmath_add(linmath_mul(linmath_load(M[2]), linmath_splat(v[2])), linmath_mul(linmath_load(M[3]), linmath_splat(v[3]))));
+	linmath_store(r, t);
+}
+#else
 static inline void mat4x4_mul_vec4(vec4 r, mat4x4 M, vec4 v)
 {
 	int i, j;
@@ -162,6 +250,7 @@ static inline void mat4x4_mul_vec4(vec4 r, mat4x4 M, vec4 v)
 			r[j] += M[i][j] * v[i];
 	}
 }
+#endif
 static inline void mat4x4_translate(mat4x4 T, float x, float y, float z)
 {
 	mat4x4_identity(T);
@@ -169,6 +258,16 @@ static inline void mat4x4_translate(mat4x4 T, float x, float y, float z)
 	T[3][1] = y;
 	T[3][2] = z;
 }
+#if defined(LINMATH_V4)
+static inline void mat4x4_translate_in_place(mat4x4 M, float x, float y, float z)
+{
+	/* Same as dotting each row with (x, y, z, 0): a weighted sum of the first three columns. */
+	linmath_v4 t = linmath_add(
+		linmath_add(linmath_mul(linmath_load(M[0]), linmath_splat(x)), linmath_mul(linmath_load(M[1]), linmath_splat(y))),
+		linmath_mul(linmath_load(M[2]), linmath_splat(z)));
+	linmath_store(M[3], linmath_add(linmath_load(M[3]), t));
+}
+#else
 static inline void mat4x4_translate_in_place(mat4x4 M, float x, float y, float z)
 {
 	vec4 t = {x, y, z, 0};
@@ -179,6 +278,29 @@ static inline void mat4x4_translate_in_place(mat4x4 M, float x, float y, float z
 		M[3][i] += vec4_mul_inner(r, t);
 	}
 }
+#endif
+/* Batch transform, for when many points go through the same matrix.
+ * out and in may be the same array. */
+static inline void mat4x4_mul_vec4_batch(vec4 *out, mat4x4 M, vec4 const *in, int n)
+{
+	int i;
+#if defined(LINMATH_V4)
+	linmath_v4 c0 = linmath_load(M[0]), c1 = linmath_load(M[1]);
+	linmath_v4 c2 = linmath_load(M[2]), c3 = linmath_load(M[3]);
+	for(i=0; i<n; ++i) {
+		linmath_v4 t = linmath_add(
+			linmath_add(linmath_mul(c0, linmath_splat(in[i][0])), linmath_mul(c1, linmath_splat(in[i][1]))),
+			linmath_add(linmath_mul(c2, linmath_splat(in[i][2])), linmath_mul(c3, linmath_splat(in[i][3]))));
+		linmath_store(out[i], t);
+	}
+#else
+	for(i=0; i<n; ++i) {
+		vec4 t;
+		mat4x4_mul_vec4(t, M, (float *)in[i]);
+		out[i][0] = t[0]; out[i][1] = t[1]; out[i][2] = t[2]; out[i][3] = t[3];
+	}
+#endif
+}
 static inline void mat4x4_from_vec3_mul_outer(mat4x4 M, vec3 a, vec3 b)
 {
 	int i, j;
@@ -441,6 +563,21 @@ static inline void quat_sub(quat r, quat a, quat b)
 	for(i=0; i<4; ++i)
 		r[i] = a[i] - b[i];
 }
+#if defined(LINMATH_SSE)
+static inline void quat_mul(quat r, quat p, quat q)
+{
+	__m128 P = _mm_loadu_ps(p), Q = _mm_loadu_ps(q);
+	__m128 cross = _mm_sub_ps(
+		_mm_mul_ps(_mm_shuffle_ps(P, P, _MM_SHUFFLE(3, 0, 2, 1)), _mm_shuffle_ps(Q, Q, _MM_SHUFFLE(3, 1, 0, 2))),
+		_mm_mul_ps(_mm_shuffle_ps(P, P, _MM_SHUFFLE(3, 1, 0, 2)), _mm_shuffle_ps(Q, Q, _MM_SHUFFLE(3, 0, 2, 1))));
+	__m128 t = _mm_add_ps(cross, _mm_add_ps(
+		_mm_mul_ps(P, _mm_shuffle_ps(Q, Q, _MM_SHUFFLE(3, 3, 3, 3))),
+		_mm_mul_ps(Q, _mm_shuffle_ps(P, P, _MM_SHUFFLE(3, 3, 3, 3)))));
+	float w = p[3]*q[3] - (p[0]*q[0] + p[1]*q[1] + p[2]*q[2]);
+	_mm_storeu_ps(r, t);
+	r[3] = w;
+}
+#else
 static inline void quat_mul(quat r, quat p, quat q)
 {
 	vec3 w;
@@ -451,6 +588,7 @@ static inline void quat_mul(quat r, quat p, quat q)
 	vec3_add(r, r, w);
 	r[3] = p[3]*q[3] - vec3_mul_inner(p, q);
 }
+#endif
 static inline void quat_scale(quat r, quat v, float s)
 {
 	int i;
@@ -0,0 +1,150 @@
+#include "pnm.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static int isPnmSpace(unsigned char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+int pnmParseHeader(const unsigned char* buf, size_t len, PnmHeader* hdr)
+{
+  uint64_t values[3];
+  size_t pos = 2;
+  int field;
+
+  if(len < 2) return len > 0 && buf[0] != 'P' ? PNM_ERR_MAGIC : PNM_NEED_MORE;
+  if(buf[0] != 'P' || (buf[1] != '5' && buf[1] != '6')) return PNM_ERR_MAGIC;
+
+  //width, height and maxval, each preceded by whitespace and possibly comments
+  for(field = 0; field < 3; field++) {
+    int sawSpace = 0;
+    uint64_t v = 0;
+
+    for(;;) {
+      if(pos >= len) goto needMore;
+      if(isPnmSpace(buf[pos])) {
+        sawSpace = 1;
+        pos++;
+      } else if(buf[pos] == '#') {
+        //a comment runs to the end of the line
+        while(buf[pos] != '\n' && buf[pos] != '\r') {
+          if(++pos >= len) goto needMore;
+        }
+      } else {
+        break;
+      }
+    }
+    if(!sawSpace || buf[pos] < '0' || buf[pos] > '9') return PNM_ERR_SYNTAX;
+
+    while(pos < len && buf[pos] >= '0' && buf[pos] <= '9') {
+      v = v * 10 + (buf[pos] - '0');
+      //no field may go beyond 32 bits, which also stops v itself from wrapping
+      if(v > 0xFFFFFFFFu) return PNM_ERR_OVERFLOW;
+      pos++;
+    }
+    //the digits might carry on in bytes we have not seen yet
+    if(pos >= len) goto needMore;
+    values[field] = v;
+  }
+
+  //a single whitespace byte separates maxval from the pixels, anything else is payload
+  if(!isPnmSpace(buf[pos])) return PNM_ERR_SYNTAX;
+  pos++;
+
+  if(values[0] == 0 || values[1] == 0 || values[2] == 0 || values[2] > 65535)
+    return PNM_ERR_RANGE;
+
+  hdr->format = buf[1] - '0';
+  hdr->channels = hdr->format == 6 ? 3 : 1;
+  hdr->bytesPerSample = values[2] < 256 ? 1 : 2;
+  hdr->width = (unsigned int)values[0];
+  hdr->height = (unsigned int)values[1];
+  hdr->maxval = (unsigned int)values[2];
+  hdr->offset = pos;
+
+  //width * channels * bytes fits easily in 64 bits, but size_t may be narrower
+  if(hdr->width > SIZE_MAX / (size_t)(hdr->channels * hdr->bytesPerSample))
+    return PNM_ERR_OVERFLOW;
+  hdr->rowBytes = (size_t)hdr->width * hdr->channels * hdr->bytesPerSample;
+  if(hdr->height > SIZE_MAX / hdr->rowBytes)
+    return PNM_ERR_OVERFLOW;
+  hdr->payloadBytes = hdr->rowBytes * hdr->height;
+  return PNM_OK;
+
+needMore:
+  return len >= PNM_MAX_HEADER ? PNM_ERR_TOO_LONG : PNM_NEED_MORE;
+}
+
+int pnmReadHeader(FILE* f, PnmHeader* hdr)
+{
+  unsigned char buf[PNM_MAX_HEADER];
+  size_t len = 0;
+  long start = ftell(f);
+  int c, result = PNM_NEED_MORE;
+
+  //a file we can seek in is read ahead in one go and rewound to the first pixel
+  if(start >= 0) {
+    len = fread(buf, 1, sizeof(buf), f);
+    if(len == 0) return PNM_ERR_IO;
+    result = pnmParseHeader(buf, len, hdr);
+    if(result == PNM_OK && fseek(f, start + (long)hdr->offset, SEEK_SET) != 0) return PNM_ERR_IO;
+    if(result != PNM_NEED_MORE) return result;
+    return len >= PNM_MAX_HEADER ? PNM_ERR_TOO_LONG : PNM_ERR_SYNTAX;
+  }
+
+  //a pipe is read byte by byte so nothing past the header is consumed. a header can only be
+  //complete on the whitespace right after the last digit of maxval, so that is the only time to scan
+  while(len < PNM_MAX_HEADER && (c = getc(f)) != EOF) {
+    buf[len++] = (unsigned char)c;
+    if(len == 2 || (len > 2 && isPnmSpace((unsigned char)c) && buf[len - 2] >= '0' && buf[len - 2] <= '9')) {
+      result = pnmParseHeader(buf, len, hdr);
+      if(result != PNM_NEED_MORE) return result;
+    }
+  }
+  if(len >= PNM_MAX_HEADER) return PNM_ERR_TOO_LONG;
+  return len == 0 ? PNM_ERR_IO : PNM_ERR_SYNTAX;
+}
+
+const char* pnmErrorString(int code)
+{
+  switch(code) {
+  case PNM_OK: return "ok";
+  case PNM_NEED_MORE: return "header is incomplete";
+  case PNM_ERR_MAGIC: return "not a binary P5/P6 file";
+  case PNM_ERR_SYNTAX: return "malformed header";
+  case PNM_ERR_RANGE: return "width, height or maxval out of range";
+  case PNM_ERR_OVERFLOW: return "image is too large to address";
+  case PNM_ERR_TOO_LONG: return "header is too long";
+  case PNM_ERR_IO: return "unable to read the header";
+  }
+  return "unknown error";
+}
+
+void pnmToRgb8(unsigned char* dst, const unsigned char* src, const PnmHeader* hdr, size_t rows)
+{
+  size_t samples = (size_t)hdr->width * hdr->channels * rows;
+  size_t i;
+
+  //the common case is already in the right layout
+  if(hdr->format == 6 && hdr->maxval == 255) {
+    memcpy(dst, src, samples);
+    return;
+  }
+
+  for(i = 0; i < samples; i++) {
+    unsigned int v = hdr->bytesPerSample == 2 ? (src[2 * i] << 8) | src[2 * i + 1] : src[i];
+    unsigned char out;
+
+    //values above maxval are invalid, clamp them rather than wrapping
+    if(v > hdr->maxval) v = hdr->maxval;
+    out = (unsigned char)((v * 255u + hdr->maxval / 2) / hdr->maxval);
+
+    if(hdr->channels == 1) {
+      dst[3 * i] = dst[3 * i + 1] = dst[3 * i + 2] = out;
+    } else {
+      dst[i] = out;
+    }
+  }
+}
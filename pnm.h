@@ -0,0 +1,45 @@
+#ifndef PNM_H
+#define PNM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+//longest header we are willing to scan, comments included
+#define PNM_MAX_HEADER 4096
+
+//results of parsing a header, errors are negative
+enum {
+  PNM_OK = 0,
+  PNM_NEED_MORE = 1,
+  PNM_ERR_MAGIC = -1,
+  PNM_ERR_SYNTAX = -2,
+  PNM_ERR_RANGE = -3,
+  PNM_ERR_OVERFLOW = -4,
+  PNM_ERR_TOO_LONG = -5,
+  PNM_ERR_IO = -6
+};
+
+//everything needed to locate and interpret the pixels of a binary P5/P6 file
+typedef struct {
+  int format;             //5 for a graymap, 6 for a pixmap
+  int channels;           //1 or 3
+  int bytesPerSample;     //1 when maxval < 256, otherwise 2 (big endian)
+  unsigned int width;
+  unsigned int height;
+  unsigned int maxval;
+  size_t offset;          //bytes from the start of the header to the first pixel
+  size_t rowBytes;
+  size_t payloadBytes;
+} PnmHeader;
+
+// scan a header held in buf without allocating. returns PNM_NEED_MORE if buf ends before
+// the header does, in which case call again with more bytes from the same start
+int pnmParseHeader(const unsigned char* buf, size_t len, PnmHeader* hdr);
+// parse the header at the current position of f and leave f at the first pixel
+int pnmReadHeader(FILE* f, PnmHeader* hdr);
+// human readable message for a negative result
+const char* pnmErrorString(int code);
+// expand rows of any supported layout to 8 bit RGB. src and dst may not overlap
+void pnmToRgb8(unsigned char* dst, const unsigned char* src, const PnmHeader* hdr, size_t rows);
+
+#endif
@@ -0,0 +1,178 @@
+// Reference producer for ezview --shm. Publishes frames into a shared memory
+// segment, either a moving test pattern or a .ppm scrolled sideways.
+//
+// Usage: ./ezview-producer /name [image.ppm] [fps]
+
+#include "shm.h"
+#include "pnm.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static volatile sig_atomic_t running = 1;
+
+//remove the name only while it is still ours, another producer may have replaced it since
+static void unlinkIfOurs(const char* name, ino_t ino)
+{
+  struct stat st;
+  int fd = shm_open(name, O_RDONLY, 0);
+
+  if(fd < 0) return;
+  if(fstat(fd, &st) == 0 && st.st_ino == ino) shm_unlink(name);
+  close(fd);
+}
+
+static void stop(int sig)
+{
+  (void)sig;
+  running = 0;
+}
+
+//diagonal bands that move with the frame number, so torn or dropped frames are easy to see
+static void drawPattern(unsigned char* dst, uint32_t w, uint32_t h, uint64_t n)
+{
+  uint32_t x, y;
+  for(y = 0; y < h; y++) {
+    for(x = 0; x < w; x++) {
+      unsigned char* p = dst + ((size_t)y * w + x) * 3;
+      p[0] = (unsigned char)(x + n * 4);
+      p[1] = (unsigned char)(y + n * 2);
+      p[2] = (unsigned char)((x + y + n * 8) & 0x80 ? 255 : 40);
+    }
+  }
+}
+
+//the source image, shifted left by n pixels and wrapped around
+static void drawScrolled(unsigned char* dst, const unsigned char* src, uint32_t w, uint32_t h, uint64_t n)
+{
+  size_t row = (size_t)w * 3, shift = (size_t)(n % w) * 3;
+  uint32_t y;
+  for(y = 0; y < h; y++) {
+    memcpy(dst + y * row, src + y * row + shift, row - shift);
+    memcpy(dst + y * row + row - shift, src + y * row, shift);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  const char* name;
+  unsigned char* image = NULL;
+  uint32_t width = 640, height = 480;
+  double fps = 30;
+  ShmHeader* hdr;
+  struct stat st;
+  size_t size;
+  uint64_t n;
+  int fd;
+
+  if(argc < 2 || argc > 4) {
+    fprintf(stderr, "Usage: ./ezview-producer /name [image.ppm] [fps]\n");
+    return 1;
+  }
+  name = argv[1];
+  if(argc > 2) {
+    char* end;
+    double value = strtod(argv[argc - 1], &end);
+    //the last argument is the rate if it is a number
+    if(*end == '\0' && value > 0) {
+      fps = value;
+      argc--;
+    }
+  }
+
+  if(argc > 2) {
+    FILE* f = fopen(argv[2], "rb");
+    PnmHeader ph;
+    unsigned char* raw;
+    int result;
+
+    if(f == NULL) {
+      perror("Unable to open the image");
+      return 1;
+    }
+    result = pnmReadHeader(f, &ph);
+    if(result != PNM_OK || shmSegmentSize(ph.width, ph.height) == 0) {
+      fprintf(stderr, "Unable to read image: %s\n",
+              pnmErrorString(result != PNM_OK ? result : PNM_ERR_OVERFLOW));
+      return 1;
+    }
+    raw = malloc(ph.payloadBytes);
+    image = malloc((size_t)ph.width * ph.height * 3);
+    if(raw == NULL || image == NULL || fread(raw, 1, ph.payloadBytes, f) != ph.payloadBytes) {
+      fprintf(stderr, "Unable to read image: file is truncated\n");
+      return 1;
+    }
+    pnmToRgb8(image, raw, &ph, ph.height);
+    free(raw);
+    fclose(f);
+    width = ph.width;
+    height = ph.height;
+  }
+
+  //always a fresh segment. resizing one left by an earlier run would pull pages out from under a
+  //viewer still mapping it, this way it keeps the old one until it notices the new one
+  size = shmSegmentSize(width, height);
+  shm_unlink(name);
+  fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if(fd < 0) {
+    perror("Unable to create the shared memory segment");
+    return 1;
+  }
+  if(fstat(fd, &st) != 0 || ftruncate(fd, size) != 0) {
+    perror("Unable to size the shared memory segment");
+    close(fd);
+    shm_unlink(name);
+    return 1;
+  }
+  hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(hdr == MAP_FAILED) {
+    perror("Unable to map the shared memory segment");
+    shm_unlink(name);
+    return 1;
+  }
+
+  //everything but the magic first, so a viewer never sees a half written header as valid
+  memset(hdr, 0, sizeof(ShmHeader));
+  hdr->version = SHM_VERSION;
+  hdr->width = width;
+  hdr->height = height;
+  hdr->slots = SHM_SLOTS;
+  hdr->frameBytes = (uint64_t)width * height * 3;
+  hdr->dataOffset = shmDataOffset();
+  atomic_thread_fence(memory_order_release);
+  hdr->magic = SHM_MAGIC;
+
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  printf("Publishing %ux%u frames on %s at %.1f fps, ctrl-c to stop\n", width, height, name, fps);
+
+  for(n = 1; running; n++) {
+    unsigned int slot = (unsigned int)(n % SHM_SLOTS);
+    struct timespec pause;
+
+    //take the slot out of circulation, fill it, then publish it
+    atomic_store_explicit(&hdr->sequence[slot], 0, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if(image) drawScrolled(shmSlot(hdr, slot), image, width, height, n);
+    else drawPattern(shmSlot(hdr, slot), width, height, n);
+    atomic_store_explicit(&hdr->sequence[slot], n, memory_order_release);
+    atomic_store_explicit(&hdr->latest, n, memory_order_release);
+
+    pause.tv_sec = (time_t)(1.0 / fps);
+    pause.tv_nsec = (long)((1.0 / fps - pause.tv_sec) * 1e9);
+    nanosleep(&pause, NULL);
+  }
+
+  munmap(hdr, size);
+  unlinkIfOurs(name, st.st_ino);
+  free(image);
+  return 0;
+}
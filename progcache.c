@@ -0,0 +1,157 @@
+#include "progcache.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+//GL_ARB_get_program_binary isn't in every header, so look the entry points up at run time
+typedef void (*GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* format, void* binary);
+typedef void (*ProgramBinaryProc)(GLuint program, GLenum format, const void* binary, GLsizei length);
+typedef void (*ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+static GetProgramBinaryProc getProgramBinary;
+static ProgramBinaryProc programBinary;
+static ProgramParameteriProc programParameteri;
+
+static int available(void)
+{
+  static int checked = 0, supported = 0;
+
+  if(checked) return supported;
+  checked = 1;
+  if(!glHasExtension("GL_ARB_get_program_binary")) return 0;
+  getProgramBinary = (GetProgramBinaryProc)glProcAddress("glGetProgramBinary");
+  programBinary = (ProgramBinaryProc)glProcAddress("glProgramBinary");
+  programParameteri = (ProgramParameteriProc)glProcAddress("glProgramParameteri");
+  supported = getProgramBinary && programBinary && programParameteri;
+  return supported;
+}
+
+static uint64_t fnv1a(uint64_t hash, const char* text)
+{
+  if(text == NULL) text = "";
+  //hash the terminator too, so "ab" + "c" and "a" + "bc" differ
+  do {
+    hash ^= (unsigned char)*text;
+    hash *= 0x100000001b3ULL;
+  } while(*text++);
+  return hash;
+}
+
+//binaries are only valid for the driver that made them, so the driver strings go into the name
+static int cachePath(char* path, size_t size, const char* vertexText, const char* fragmentText)
+{
+  const char* base = getenv("XDG_CACHE_HOME");
+  const char* home = getenv("HOME");
+  char dir[1024];
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  hash = fnv1a(hash, (const char*)glGetString(GL_VENDOR));
+  hash = fnv1a(hash, (const char*)glGetString(GL_RENDERER));
+  hash = fnv1a(hash, (const char*)glGetString(GL_VERSION));
+  hash = fnv1a(hash, vertexText);
+  hash = fnv1a(hash, fragmentText);
+
+  if(base && *base) snprintf(dir, sizeof(dir), "%s/ezview", base);
+  else if(home && *home) snprintf(dir, sizeof(dir), "%s/.cache/ezview", home);
+  else return 0;
+
+  snprintf(path, size, "%s/program-%016llx.bin", dir, (unsigned long long)hash);
+  return 1;
+}
+
+GLuint progCacheLoad(const char* vertexText, const char* fragmentText)
+{
+  char path[1100];
+  FILE* f;
+  GLenum format;
+  long length;
+  void* binary;
+  GLuint program;
+  GLint linked = 0;
+
+  if(!available() || !cachePath(path, sizeof(path), vertexText, fragmentText)) return 0;
+  f = fopen(path, "rb");
+  if(f == NULL) return 0;
+
+  //the file is the binary format followed by the binary
+  if(fread(&format, sizeof(format), 1, f) != 1 || fseek(f, 0, SEEK_END) != 0 ||
+     (length = ftell(f) - (long)sizeof(format)) <= 0 || fseek(f, sizeof(format), SEEK_SET) != 0) {
+    fclose(f);
+    return 0;
+  }
+  binary = malloc(length);
+  if(binary == NULL || fread(binary, 1, length, f) != (size_t)length) {
+    free(binary);
+    fclose(f);
+    return 0;
+  }
+  fclose(f);
+
+  program = glCreateProgram();
+  programBinary(program, format, binary, (GLsizei)length);
+  free(binary);
+
+  //a driver update can reject an old binary, then it's compiled again and the entry replaced
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if(!linked) {
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+void progCacheHint(GLuint program)
+{
+  if(available())
+    programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void progCacheStore(GLuint program, const char* vertexText, const char* fragmentText)
+{
+  char path[1100], partial[1110];
+  char* slash;
+  GLint length = 0;
+  GLsizei written = 0;
+  GLenum format;
+  void* binary;
+  FILE* f;
+
+  if(!available() || !cachePath(path, sizeof(path), vertexText, fragmentText)) return;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if(length <= 0) return;
+  binary = malloc(length);
+  if(binary == NULL) return;
+  getProgramBinary(program, length, &written, &format, binary);
+
+  //make the directories, ignoring ones that are already there
+  slash = strrchr(path, '/');
+  *slash = '\0';
+  {
+    char* p = strrchr(path, '/');
+    *p = '\0';
+    mkdir(path, 0700);
+    *p = '/';
+  }
+  mkdir(path, 0700);
+  *slash = '/';
+
+  //write next to the real name and rename over it, so another ezview never reads half a file
+  snprintf(partial, sizeof(partial), "%s.%d", path, (int)getpid());
+  f = fopen(partial, "wb");
+  if(f != NULL) {
+    int ok = written > 0 && fwrite(&format, sizeof(format), 1, f) == 1 &&
+             fwrite(binary, 1, written, f) == (size_t)written;
+    if(fclose(f) != 0) ok = 0;
+    if(!ok || rename(partial, path) != 0) remove(partial);
+  }
+  free(binary);
+}
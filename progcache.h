@@ -0,0 +1,14 @@
+#ifndef PROGCACHE_H
+#define PROGCACHE_H
+
+#include "glcompat.h"
+
+// a linked program for these shader sources saved by an earlier run on the same driver, or 0.
+// needs a current context
+GLuint progCacheLoad(const char* vertexText, const char* fragmentText);
+// ask the driver to keep the binary around, call between creating the program and linking it
+void progCacheHint(GLuint program);
+// save a linked program so the next run can skip compiling and linking
+void progCacheStore(GLuint program, const char* vertexText, const char* fragmentText);
+
+#endif
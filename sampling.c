@@ -0,0 +1,187 @@
+#include "sampling.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#ifndef GL_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT 0x84FF
+#endif
+
+//resolution of the table used to go back from linear light to sRGB bytes
+#define TO_SRGB_STEPS 4096
+
+static float srgbToLinear[256];
+static unsigned char linearToSrgb[TO_SRGB_STEPS];
+//mip chains are built on the loader, thumbnail and render threads at once, the first one fills the tables
+static pthread_once_t tablesOnce = PTHREAD_ONCE_INIT;
+
+static void buildGammaTables(void)
+{
+  int i;
+
+  for(i = 0; i < 256; i++) {
+    float c = i / 255.0f;
+    srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+  }
+  for(i = 0; i < TO_SRGB_STEPS; i++) {
+    float l = i / (float)(TO_SRGB_STEPS - 1);
+    float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+    linearToSrgb[i] = (unsigned char)(c * 255.0f + 0.5f);
+  }
+}
+
+int mipLevelCount(int w, int h)
+{
+  int levels = 1;
+  while(w > 1 || h > 1) {
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+    levels++;
+  }
+  return levels;
+}
+
+void downsampleSrgb(unsigned char* dst, const unsigned char* src, int w, int h)
+{
+  int nw = w > 1 ? w / 2 : 1;
+  int nh = h > 1 ? h / 2 : 1;
+  int x, y, k;
+
+  pthread_once(&tablesOnce, buildGammaTables);
+
+  for(y = 0; y < nh; y++) {
+    const unsigned char* r0 = src + (size_t)(2 * y) * w * 3;
+    const unsigned char* r1 = src + (size_t)(2 * y + 1 < h ? 2 * y + 1 : 2 * y) * w * 3;
+    unsigned char* out = dst + (size_t)y * nw * 3;
+
+    for(x = 0; x < nw; x++) {
+      int x0 = 2 * x * 3;
+      int x1 = (2 * x + 1 < w ? 2 * x + 1 : 2 * x) * 3;
+      for(k = 0; k < 3; k++) {
+        //averaging the encoded bytes would darken every level, so do it in linear light
+        float l = (srgbToLinear[r0[x0 + k]] + srgbToLinear[r0[x1 + k]] +
+                   srgbToLinear[r1[x0 + k]] + srgbToLinear[r1[x1 + k]]) * 0.25f;
+        out[x * 3 + k] = linearToSrgb[(int)(l * (TO_SRGB_STEPS - 1) + 0.5f)];
+      }
+    }
+  }
+}
+
+int buildMipChain(MipChain* chain, unsigned char* image, int w, int h)
+{
+  int level;
+
+  memset(chain, 0, sizeof(MipChain));
+  chain->levels = mipLevelCount(w, h);
+  chain->width[0] = w;
+  chain->height[0] = h;
+  chain->data[0] = image;
+
+  for(level = 1; level < chain->levels; level++) {
+    int pw = chain->width[level - 1], ph = chain->height[level - 1];
+    chain->width[level] = pw > 1 ? pw / 2 : 1;
+    chain->height[level] = ph > 1 ? ph / 2 : 1;
+    chain->data[level] = malloc((size_t)chain->width[level] * chain->height[level] * 3);
+    if(chain->data[level] == NULL) {
+      freeMipChain(chain);
+      return 0;
+    }
+    downsampleSrgb(chain->data[level], chain->data[level - 1], pw, ph);
+  }
+  return 1;
+}
+
+void uploadMipChain(const MipChain* chain)
+{
+  int level;
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for(level = 0; level < chain->levels; level++)
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, chain->width[level], chain->height[level], 0,
+                 GL_RGB, GL_UNSIGNED_BYTE, chain->data[level]);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, chain->levels - 1);
+}
+
+void freeMipChain(MipChain* chain)
+{
+  int level;
+
+  for(level = 1; level < chain->levels; level++) {
+    free(chain->data[level]);
+    chain->data[level] = NULL;
+  }
+  chain->levels = chain->data[0] ? 1 : 0;
+}
+
+void samplingInit(Sampling* s)
+{
+  const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+
+  memset(s, 0, sizeof(Sampling));
+  s->quality = 1;
+  s->maxAniso = 1.0f;
+  s->hasAniso = extensions != NULL && strstr(extensions, "GL_EXT_texture_filter_anisotropic") != NULL;
+  if(s->hasAniso)
+    glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &s->maxAniso);
+
+  //nothing applied yet, so the first update sets everything
+  s->appliedFilter = -1;
+  s->appliedAniso = -1.0f;
+  s->appliedBias = -100.0f;
+}
+
+float samplingFootprint(int imageWidth, int imageHeight, int viewWidth, int viewHeight, float scale)
+{
+  float across, down;
+
+  if(viewWidth <= 0 || viewHeight <= 0 || scale <= 0) return 1.0f;
+  across = imageWidth / (viewWidth * scale);
+  down = imageHeight / (viewHeight * scale);
+  return across > down ? across : down;
+}
+
+float samplingBias(int quality, float texels)
+{
+  float lod, ramp;
+
+  //level 0 is used as it is while magnifying, so only shrinking needs a bias
+  if(texels <= 1.0f) return 0.0f;
+  lod = log2f(texels);
+  //eased in over the first level, so zooming out past 1:1 doesn't jump to a blurrier or sharper level
+  ramp = lod < 1.0f ? lod : 1.0f;
+  //box filtered levels are a little soft, quality leans towards the sharper level. performance leans
+  //towards the coarser one to save bandwidth
+  return quality ? -0.25f * ramp : 0.5f * ramp;
+}
+
+void samplingUpdate(Sampling* s, float texels, float shear)
+{
+  GLint filter;
+  float aniso = 1.0f, bias = samplingBias(s->quality, texels);
+
+  if(s->quality) {
+    //blend between the two nearest levels and sample along the sheared axis
+    filter = GL_LINEAR_MIPMAP_LINEAR;
+    if(shear != 0 && s->hasAniso)
+      aniso = s->maxAniso < 8.0f ? s->maxAniso : 8.0f;
+  } else {
+    //one level per fetch to save bandwidth while zoomed out
+    filter = GL_LINEAR_MIPMAP_NEAREST;
+  }
+
+  if(filter != s->appliedFilter) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    s->appliedFilter = filter;
+  }
+  if(s->hasAniso && aniso != s->appliedAniso) {
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso);
+    s->appliedAniso = aniso;
+  }
+  if(bias != s->appliedBias) {
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, bias);
+    s->appliedBias = bias;
+  }
+}
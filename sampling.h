@@ -0,0 +1,48 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "glcompat.h"
+
+//enough levels for any texture GL can hold
+#define MAX_MIP_LEVELS 32
+
+//an image and its smaller copies, level 0 is the caller's image and is not owned
+typedef struct {
+  int levels;
+  int width[MAX_MIP_LEVELS];
+  int height[MAX_MIP_LEVELS];
+  unsigned char* data[MAX_MIP_LEVELS];
+} MipChain;
+
+//texture sampling state for the image, tracked so parameters are only touched when they change
+typedef struct {
+  int quality;          //1 = trilinear with anisotropy, 0 = cheaper nearest-mip bilinear
+  int hasAniso;
+  float maxAniso;
+
+  GLint appliedFilter;
+  float appliedAniso;
+  float appliedBias;
+} Sampling;
+
+// number of levels in a full mip chain for a w x h image
+int mipLevelCount(int w, int h);
+// halve an RGB image with a 2x2 box filter averaged in linear light
+void downsampleSrgb(unsigned char* dst, const unsigned char* src, int w, int h);
+// build a gamma-correct mip chain for image on the CPU, needs no GL so it can run on any thread
+int buildMipChain(MipChain* chain, unsigned char* image, int w, int h);
+// upload every level into the bound GL_TEXTURE_2D
+void uploadMipChain(const MipChain* chain);
+// free the levels the chain allocated, leaving level 0 alone
+void freeMipChain(MipChain* chain);
+
+// level 0 texels one screen pixel covers, for an image stretched over a view and zoomed by scale
+float samplingFootprint(int imageWidth, int imageHeight, int viewWidth, int viewHeight, float scale);
+// LOD bias for sampling with that footprint, the same on the GPU and the CPU
+float samplingBias(int quality, float texels);
+// look up what the driver supports, start in quality mode
+void samplingInit(Sampling* s);
+// pick filter, anisotropy and LOD bias for the current footprint and shear
+void samplingUpdate(Sampling* s, float texels, float shear);
+
+#endif
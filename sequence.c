@@ -0,0 +1,250 @@
+#include "sequence.h"
+#include "pnm.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+//the pattern goes to snprintf as the format, so it may hold one %d or %0Nd for the frame
+//number and %% for a literal percent sign, nothing else
+static int validPattern(const char* pattern)
+{
+  const char* p;
+  int numbers = 0, digits;
+
+  for(p = pattern; *p; p++) {
+    if(*p != '%') continue;
+    p++;
+    if(*p == '%') continue;
+    digits = 0;
+    if(*p == '0')
+      for(p++; *p >= '0' && *p <= '9'; p++) digits++;
+    if(*p != 'd' || digits > 2 || (digits == 0 && p[-1] == '0')) return 0;
+    numbers++;
+  }
+  return numbers == 1;
+}
+
+static void framePath(Sequence* seq, int frame, char* path, size_t size)
+{
+  snprintf(path, size, seq->pattern, seq->first + frame);
+}
+
+static int frameExists(const char* pattern, int number)
+{
+  char path[4096];
+  snprintf(path, sizeof(path), pattern, number);
+  return access(path, R_OK) == 0;
+}
+
+//read one frame into a staging buffer, it has to match the size of the first one
+static int decodeFrame(Sequence* seq, int frame, unsigned char* pixels)
+{
+  char path[4096];
+  PnmHeader hdr;
+  FILE* f;
+  int ok = 0;
+
+  framePath(seq, frame, path, sizeof(path));
+  f = fopen(path, "rb");
+  if(f == NULL) return 0;
+
+  if(pnmReadHeader(f, &hdr) == PNM_OK &&
+     hdr.width == (unsigned int)seq->width && hdr.height == (unsigned int)seq->height) {
+    if(hdr.format == 6 && hdr.maxval == 255) {
+      ok = fread(pixels, 1, hdr.payloadBytes, f) == hdr.payloadBytes;
+    } else {
+      unsigned char* raw = malloc(hdr.payloadBytes);
+      if(raw && fread(raw, 1, hdr.payloadBytes, f) == hdr.payloadBytes) {
+        pnmToRgb8(pixels, raw, &hdr, hdr.height);
+        ok = 1;
+      }
+      free(raw);
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+//the k-th frame after the playhead, or -1 past the end when not looping
+static int frameAhead(Sequence* seq, int k)
+{
+  int f = seq->playhead + k;
+  if(f < seq->count) return f;
+  return seq->loop ? f % seq->count : -1;
+}
+
+static void* sequenceWorker(void* arg)
+{
+  Sequence* seq = arg;
+
+  pthread_mutex_lock(&seq->lock);
+  while(!seq->quit) {
+    SeqSlot* slot = NULL;
+    int k, frame = -1;
+
+    //claim the nearest frame in the window that nobody has decoded or is decoding. a slot still
+    //loading an older frame belongs to its worker until it finishes, even if the playhead moved on
+    for(k = 0; k < seq->depth && slot == NULL; k++) {
+      SeqSlot* candidate;
+      frame = frameAhead(seq, k);
+      if(frame < 0) break;
+      candidate = &seq->ring[frame % SEQ_RING];
+      if(candidate->frame != frame && candidate->state != SLOT_LOADING)
+        slot = candidate;
+    }
+    if(slot == NULL) {
+      pthread_cond_wait(&seq->wake, &seq->lock);
+      continue;
+    }
+    if(slot->pixels == NULL) {
+      slot->pixels = malloc((size_t)seq->width * seq->height * 3);
+      if(slot->pixels == NULL) {
+        //try again once something has been freed or the playhead moves
+        pthread_cond_wait(&seq->wake, &seq->lock);
+        continue;
+      }
+      seq->allocated++;
+      memResize(&seq->block, (size_t)seq->allocated * seq->width * seq->height * 3);
+    }
+    slot->frame = frame;
+    slot->state = SLOT_LOADING;
+
+    pthread_mutex_unlock(&seq->lock);
+    k = decodeFrame(seq, frame, slot->pixels);
+    pthread_mutex_lock(&seq->lock);
+
+    //nobody else touches a loading slot, so it still holds this frame. if the playhead jumped away
+    //meanwhile the frame is simply outside the window, and a worker waiting for the slot can have it
+    slot->state = k ? SLOT_READY : SLOT_FAILED;
+    pthread_cond_broadcast(&seq->wake);
+  }
+  pthread_mutex_unlock(&seq->lock);
+  return NULL;
+}
+
+//decode fewer frames ahead and free the slots that fall out of the window. the frame on screen is
+//already in the texture, so only frames still to come need their buffers
+static int shrinkPrefetch(MemBlock* block)
+{
+  Sequence* seq = block->user;
+  int inWindow[SEQ_RING] = {0};
+  int i, k, freed = 0;
+
+  pthread_mutex_lock(&seq->lock);
+  if(seq->depth > 2) seq->depth /= 2;
+  for(k = 0; k < seq->depth; k++) {
+    int frame = frameAhead(seq, k);
+    if(frame < 0) break;
+    inWindow[frame % SEQ_RING] = 1;
+  }
+  for(i = 0; i < SEQ_RING; i++) {
+    SeqSlot* slot = &seq->ring[i];
+    if(slot->pixels == NULL || inWindow[i] || slot->state == SLOT_LOADING) continue;
+    free(slot->pixels);
+    slot->pixels = NULL;
+    slot->frame = -1;
+    slot->state = SLOT_EMPTY;
+    seq->allocated--;
+    freed++;
+  }
+  memResize(block, (size_t)seq->allocated * seq->width * seq->height * 3);
+  pthread_mutex_unlock(&seq->lock);
+  return freed > 0;
+}
+
+Sequence* sequenceOpen(const char* pattern, double fps)
+{
+  Sequence* seq;
+  char path[4096];
+  PnmHeader hdr;
+  FILE* f;
+  int first, count, step, i;
+
+  if(!validPattern(pattern)) {
+    fprintf(stderr, "Invalid frame pattern %s, it needs one %%d or %%0Nd for the frame number and %%%% for a literal %%\n", pattern);
+    return NULL;
+  }
+
+  //numbering usually starts at 0 or 1
+  if(frameExists(pattern, 0)) first = 0;
+  else if(frameExists(pattern, 1)) first = 1;
+  else {
+    fprintf(stderr, "No frames found matching %s\n", pattern);
+    return NULL;
+  }
+
+  //gallop forward, then binary search for the last frame
+  step = 1;
+  while(frameExists(pattern, first + step * 2 - 1)) step *= 2;
+  count = step;
+  for(i = step / 2; i > 0; i /= 2)
+    if(frameExists(pattern, first + count + i - 1)) count += i;
+
+  //every frame is assumed to be the size of the first
+  snprintf(path, sizeof(path), pattern, first);
+  f = fopen(path, "rb");
+  if(f == NULL) return NULL;
+  i = pnmReadHeader(f, &hdr);
+  fclose(f);
+  if(i != PNM_OK || hdr.width > 0x7FFFFFFF || hdr.height > 0x7FFFFFFF ||
+     (size_t)hdr.width * hdr.height > SIZE_MAX / 3) {
+    fprintf(stderr, "Unable to read %s: %s\n", path, pnmErrorString(i != PNM_OK ? i : PNM_ERR_OVERFLOW));
+    return NULL;
+  }
+
+  seq = calloc(1, sizeof(Sequence));
+  seq->pattern = pattern;
+  seq->first = first;
+  seq->count = count;
+  seq->width = (int)hdr.width;
+  seq->height = (int)hdr.height;
+  seq->fps = fps;
+  seq->playing = 1;
+  seq->loop = 1;
+  seq->current = -1;
+
+  seq->depth = SEQ_RING;
+  for(i = 0; i < SEQ_RING; i++)
+    seq->ring[i].frame = -1;
+  memTrack(&seq->block, MEM_CPU, "sequence prefetch", 0, shrinkPrefetch, seq);
+  pthread_mutex_init(&seq->lock, NULL);
+  pthread_cond_init(&seq->wake, NULL);
+  for(i = 0; i < SEQ_WORKERS; i++)
+    pthread_create(&seq->workers[i], NULL, sequenceWorker, seq);
+
+  return seq;
+}
+
+void sequenceClose(Sequence* seq)
+{
+  int i;
+
+  pthread_mutex_lock(&seq->lock);
+  seq->quit = 1;
+  pthread_cond_broadcast(&seq->wake);
+  pthread_mutex_unlock(&seq->lock);
+  for(i = 0; i < SEQ_WORKERS; i++)
+    pthread_join(seq->workers[i], NULL);
+
+  memUntrack(&seq->block);
+  for(i = 0; i < SEQ_RING; i++)
+    free(seq->ring[i].pixels);
+  pthread_cond_destroy(&seq->wake);
+  pthread_mutex_destroy(&seq->lock);
+  free(seq);
+}
+
+//move the playhead and let the workers start on the frames after it
+void sequenceSeek(Sequence* seq, int frame)
+{
+  if(frame < 0) frame = seq->loop ? seq->count - 1 : 0;
+  if(frame >= seq->count) frame = seq->loop ? 0 : seq->count - 1;
+
+  pthread_mutex_lock(&seq->lock);
+  seq->playhead = frame;
+  pthread_cond_broadcast(&seq->wake);
+  pthread_mutex_unlock(&seq->lock);
+}
@@ -0,0 +1,60 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <pthread.h>
+#include "budget.h"
+
+//frames decoded ahead of the playhead, and threads decoding them
+#define SEQ_RING 8
+#define SEQ_WORKERS 2
+
+enum {
+  SLOT_EMPTY = 0,
+  SLOT_LOADING,
+  SLOT_READY,
+  SLOT_FAILED
+};
+
+//one staging buffer in the prefetch ring, frame f always lives in ring[f % SEQ_RING]
+typedef struct {
+  unsigned char* pixels;    //allocated when a frame is first decoded into the slot
+  int frame;
+  int state;
+} SeqSlot;
+
+typedef struct {
+  const char* pattern;      //printf style, e.g. frame_%04d.ppm
+  int first;                //number of the first frame on disk
+  int count;
+  int width, height;
+  double fps;
+
+  int playing;
+  int loop;
+  int current;              //frame on screen, -1 before the first upload
+  int playhead;             //frame that should be on screen now, workers decode ahead of it
+  double clockStart;        //time and frame that playback pacing is measured from
+  int clockFrame;
+  int shown;
+  int dropped;
+
+  SeqSlot ring[SEQ_RING];
+  int depth;                //frames decoded ahead, cut down when memory gets short
+  int allocated;            //slots holding a buffer
+  MemBlock block;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_t workers[SEQ_WORKERS];
+  int quit;
+} Sequence;
+
+// find the frames matching pattern and start decoding from the first. returns NULL, after saying why,
+// if the pattern is not a single %d or %0Nd or there are no frames
+Sequence* sequenceOpen(const char* pattern, double fps);
+void sequenceClose(Sequence* seq);
+// move the playhead to frame, wrapping or clamping it the way looping says
+void sequenceSeek(Sequence* seq, int frame);
+// play the sequence in a window, returns when it is closed
+int runSequence(const char* pattern, double fps);
+
+#endif
@@ -0,0 +1,182 @@
+#include "imagewindow.h"
+#include "sequence.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//staging buffers the uploads go through, so the GPU copy overlaps the next frame's CPU copy
+#define SEQ_PBOS 2
+
+//restart the pacing clock from the frame on screen
+static void resetClock(Sequence* seq)
+{
+  seq->clockStart = glfwGetTime();
+  seq->clockFrame = seq->current < 0 ? 0 : seq->current;
+}
+
+static void sequenceKey(View* view, int key, int mods)
+{
+  Sequence* seq = view->user;
+
+  // Play and pause with the 'SPACE' key
+  if(key == GLFW_KEY_SPACE) {
+    seq->playing = !seq->playing;
+    resetClock(seq);
+    sequenceSeek(seq, seq->current < 0 ? 0 : seq->current);
+  }
+
+  // Step a frame back or forward with '[' and ']', ten at a time with shift
+  if(key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) {
+    int step = (mods & GLFW_MOD_SHIFT) ? 10 : 1;
+    seq->playing = 0;
+    sequenceSeek(seq, seq->playhead + (key == GLFW_KEY_LEFT_BRACKET ? -step : step));
+  }
+
+  // Jump to the first or last frame with 'HOME' and 'END'
+  if(key == GLFW_KEY_HOME) {
+    sequenceSeek(seq, 0);
+    seq->current = -1;
+    resetClock(seq);
+  }
+  if(key == GLFW_KEY_END) {
+    seq->playing = 0;
+    sequenceSeek(seq, seq->count - 1);
+  }
+
+  // Toggle looping with the 'L' key
+  if(key == GLFW_KEY_L)
+    seq->loop = !seq->loop;
+}
+
+//copy a staging buffer into the texture through a pixel buffer, so the driver can upload it asynchronously
+static void uploadFrame(Sequence* seq, SeqSlot* slot, GLuint pbo)
+{
+  size_t bytes = (size_t)seq->width * seq->height * 3;
+  void* mapped;
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+  //orphan the old storage so we never wait on the transfer still reading it
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+  mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+  if(mapped) {
+    memcpy(mapped, slot->pixels, bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, seq->width, seq->height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+  } else {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, seq->width, seq->height, GL_RGB, GL_UNSIGNED_BYTE, slot->pixels);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  //regenerating on the GPU keeps up with playback, the CPU chain is for stills
+  glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+int runSequence(const char* pattern, double fps)
+{
+  Sequence* seq = sequenceOpen(pattern, fps);
+  ImageWindow iw;
+  GLuint pbos[SEQ_PBOS];
+  MemBlock textureBlock = {0};
+  int pboIndex = 0, showingMemory = 0;
+  char title[512], usage[128];
+
+  if(seq == NULL)
+    return 1;
+
+  //frames are paced from real timestamps below, not by blocking in the swap
+  imageWindowOpen(&iw, seq->width, seq->height, pattern, 0);
+  iw.view.onKey = sequenceKey;
+  iw.view.user = seq;
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, seq->width, seq->height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glGenBuffers(SEQ_PBOS, pbos);
+  //the texture and its mipmaps, plus the staging buffers
+  memTrack(&textureBlock, MEM_GPU, "sequence texture and buffers",
+           (size_t)seq->width * seq->height * 4 * 4 / 3 + (size_t)seq->width * seq->height * 3 * SEQ_PBOS, NULL, NULL);
+
+  resetClock(seq);
+
+  while (!glfwWindowShouldClose(iw.window))
+  {
+    double now = glfwGetTime(), nextDue;
+    int due = seq->playhead, tick = 0;
+    SeqSlot* slot;
+
+    //work out which frame the clock says should be up
+    if(seq->playing) {
+      tick = seq->clockFrame + (int)((now - seq->clockStart) * seq->fps);
+      due = tick;
+      if(due >= seq->count) {
+        if(seq->loop) {
+          due %= seq->count;
+        } else {
+          due = seq->count - 1;
+          seq->playing = 0;
+        }
+      }
+      if(due != seq->playhead) sequenceSeek(seq, due);
+    }
+
+    //show it if it has been decoded, otherwise keep the last frame up and check again soon
+    slot = &seq->ring[due % SEQ_RING];
+    pthread_mutex_lock(&seq->lock);
+    if(due != seq->current && slot->frame == due && slot->state == SLOT_READY) {
+      pthread_mutex_unlock(&seq->lock);
+
+      //every frame the clock passed over without us showing it was dropped
+      if(seq->playing && seq->current >= 0) {
+        int skipped = (due - seq->current + seq->count) % seq->count - 1;
+        if(skipped > 0) seq->dropped += skipped;
+      }
+      uploadFrame(seq, slot, pbos[pboIndex]);
+      pboIndex = (pboIndex + 1) % SEQ_PBOS;
+      seq->current = due;
+      seq->shown++;
+      iw.view.dirty = 1;
+      memTouch(&seq->block);
+
+      memDescribe(usage, sizeof(usage));
+      snprintf(title, sizeof(title), "%s - frame %d/%d  %.1f fps  dropped %d%s%s%s", pattern,
+               seq->first + due, seq->first + seq->count - 1, seq->fps, seq->dropped,
+               seq->playing ? "" : "  (paused)", iw.view.showMemory ? "  " : "", iw.view.showMemory ? usage : "");
+      glfwSetWindowTitle(iw.window, title);
+      showingMemory = iw.view.showMemory;
+    } else {
+      pthread_mutex_unlock(&seq->lock);
+      //paused, so bring the title up to date here
+      if(showingMemory != iw.view.showMemory) {
+        memDescribe(usage, sizeof(usage));
+        snprintf(title, sizeof(title), "%s - frame %d/%d%s%s", pattern,
+                 seq->first + (seq->current < 0 ? 0 : seq->current), seq->first + seq->count - 1, iw.view.showMemory ? "  " : "", iw.view.showMemory ? usage : "");
+        glfwSetWindowTitle(iw.window, title);
+        showingMemory = iw.view.showMemory;
+      }
+    }
+    memEnforce();
+
+    if(iw.view.dirty) {
+      iw.view.dirty = 0;
+      drawImageView(iw.window, &iw.view, &iw.prog, &iw.sampling, iw.texID, seq->width, seq->height);
+    }
+
+    //sleep until the next frame is due, or until input arrives
+    if(seq->playing) {
+      nextDue = seq->clockStart + (tick - seq->clockFrame + 1) / seq->fps;
+      if(due != seq->current) nextDue = now + 0.002;
+      if(nextDue > now) glfwWaitEventsTimeout(nextDue - now);
+      else glfwPollEvents();
+    } else if(seq->playhead != seq->current) {
+      glfwWaitEventsTimeout(0.005);
+    } else {
+      glfwWaitEvents();
+    }
+  }
+
+  fprintf(stderr, "%d frames shown, %d dropped\n", seq->shown, seq->dropped);
+  sequenceClose(seq);
+  memUntrack(&textureBlock);
+  glDeleteBuffers(SEQ_PBOS, pbos);
+  imageWindowClose(&iw);
+  return 0;
+}
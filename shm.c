@@ -0,0 +1,151 @@
+#include "imagewindow.h"
+#include "shm.h"
+#include "budget.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+ShmHeader* shmOpen(const char* name, size_t* size, ino_t* ino)
+{
+  struct stat st;
+  ShmHeader* hdr;
+  int fd = shm_open(name, O_RDONLY, 0);
+
+  if(fd < 0) return NULL;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmHeader)) {
+    close(fd);
+    return NULL;
+  }
+
+  hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(hdr == MAP_FAILED) return NULL;
+
+  //the producer fills the header in before it publishes anything, so check it matches what it claims
+  if(hdr->magic != SHM_MAGIC || hdr->version != SHM_VERSION || hdr->slots != SHM_SLOTS ||
+     hdr->width > 0x7FFFFFFF || hdr->height > 0x7FFFFFFF ||
+     shmSegmentSize(hdr->width, hdr->height) == 0 ||
+     shmSegmentSize(hdr->width, hdr->height) > (size_t)st.st_size ||
+     hdr->frameBytes != (uint64_t)hdr->width * hdr->height * 3 || hdr->dataOffset != shmDataOffset()) {
+    munmap(hdr, st.st_size);
+    return NULL;
+  }
+
+  *size = st.st_size;
+  *ino = st.st_ino;
+  return hdr;
+}
+
+//whether the mapping is still the segment under name, at the size and frame size it had when mapped.
+//reading past the end of a segment that shrank is a SIGBUS, so this runs before every read of the pixels
+static int shmCurrent(const char* name, ShmHeader* hdr, size_t size, ino_t ino, uint32_t width, uint32_t height)
+{
+  struct stat st;
+  int fd = shm_open(name, O_RDONLY, 0), same;
+
+  if(fd < 0) return 0;
+  same = fstat(fd, &st) == 0 && st.st_ino == ino && (size_t)st.st_size == size;
+  close(fd);
+  return same && hdr->magic == SHM_MAGIC && hdr->width == width && hdr->height == height;
+}
+
+int runShm(const char* name)
+{
+  ShmHeader* hdr;
+  size_t size;
+  ino_t ino;
+  uint32_t width, height;
+  ImageWindow iw;
+  MemBlock mapBlock = {0}, textureBlock = {0};
+  uint64_t shown = 0, torn = 0;
+  char title[512];
+
+  //the viewer may well start before the producer, so wait for the segment to appear
+  hdr = shmOpen(name, &size, &ino);
+  if(hdr == NULL) {
+    fprintf(stderr, "Waiting for a producer on %s\n", name);
+    while((hdr = shmOpen(name, &size, &ino)) == NULL)
+      usleep(100000);
+  }
+  width = hdr->width;
+  height = hdr->height;
+
+  imageWindowOpen(&iw, (int)width, (int)height, name, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, (int)width, (int)height, 0, GL_RGB,
+               GL_UNSIGNED_BYTE, NULL);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  //the mapping is shared with the producer, but it is still ours to count
+  memTrack(&mapBlock, MEM_CPU, "shared memory segment", size, NULL, NULL);
+  memTrack(&textureBlock, MEM_GPU, "shm texture", (size_t)width * height * 4 * 4 / 3, NULL, NULL);
+
+  //polled once per vsync, there is no cheaper way to hear about a new frame without a lock
+  while (!glfwWindowShouldClose(iw.window))
+  {
+    uint64_t latest = 0;
+
+    //the producer went away, restarted or resized the segment. drop the old mapping, keep the last
+    //frame on screen and pick up whatever is under the name now
+    if(hdr && !shmCurrent(name, hdr, size, ino, width, height)) {
+      munmap(hdr, size);
+      hdr = NULL;
+      memResize(&mapBlock, 0);
+    }
+    if(hdr == NULL && (hdr = shmOpen(name, &size, &ino)) != NULL) {
+      memResize(&mapBlock, size);
+      shown = 0;
+      if(hdr->width != width || hdr->height != height) {
+        width = hdr->width;
+        height = hdr->height;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, (int)width, (int)height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        memResize(&textureBlock, (size_t)width * height * 4 * 4 / 3);
+      }
+    }
+    if(hdr)
+      latest = atomic_load_explicit(&hdr->latest, memory_order_acquire);
+
+    if(latest != 0 && latest != shown) {
+      unsigned int slot = (unsigned int)(latest % SHM_SLOTS);
+
+      if(atomic_load_explicit(&hdr->sequence[slot], memory_order_acquire) == latest) {
+        //upload straight out of the mapping, the driver's copy is the only one
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (int)width, (int)height, GL_RGB,
+                        GL_UNSIGNED_BYTE, shmSlot(hdr, slot));
+
+        //if the producer came back round to this slot while we read it, the frame is torn.
+        //keep it on screen, the next one will replace it
+        atomic_thread_fence(memory_order_acquire);
+        if(atomic_load_explicit(&hdr->sequence[slot], memory_order_relaxed) != latest)
+          torn++;
+
+        glGenerateMipmap(GL_TEXTURE_2D);
+        shown = latest;
+        iw.view.dirty = 1;
+
+        snprintf(title, sizeof(title), "%s - frame %llu  torn %llu", name,
+                 (unsigned long long)latest, (unsigned long long)torn);
+        glfwSetWindowTitle(iw.window, title);
+      }
+    }
+
+    if(iw.view.dirty) {
+      iw.view.dirty = 0;
+      drawImageView(iw.window, &iw.view, &iw.prog, &iw.sampling, iw.texID, (int)width, (int)height);
+    } else {
+      //nothing to draw, but still check for frames at about the display rate
+      glfwWaitEventsTimeout(1.0 / 120);
+      continue;
+    }
+    glfwPollEvents();
+  }
+
+  memUntrack(&textureBlock);
+  memUntrack(&mapBlock);
+  if(hdr) munmap(hdr, size);
+  imageWindowClose(&iw);
+  return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+#define SHM_MAGIC 0x48535a45u   //"EZSH"
+#define SHM_VERSION 1
+//frames in flight. the producer has to lap the whole ring during one upload to tear a frame
+#define SHM_SLOTS 3
+
+/* Layout of the shared segment: this header, then SHM_SLOTS frames of
+ * width * height * 3 bytes, each laid out exactly like a P6 payload.
+ *
+ * To publish frame n (counting from 1) the producer clears the sequence of
+ * slot n % SHM_SLOTS, writes the pixels, stores n into the slot sequence and
+ * finally stores n into latest. The consumer reads latest, checks the slot
+ * still holds n, uploads straight from the mapping and checks again. */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t slots;
+  uint32_t reserved;
+  uint64_t frameBytes;
+  uint64_t dataOffset;      //from the start of the segment to the first slot
+  _Atomic uint64_t latest;  //newest complete frame, 0 before the first
+  _Atomic uint64_t sequence[SHM_SLOTS];
+} ShmHeader;
+
+//the producer only needs these, so they live here rather than with the viewer code
+
+// bytes taken by the header, rounded so the pixels start on their own page
+static inline size_t shmDataOffset(void)
+{
+  return (sizeof(ShmHeader) + 4095) & ~(size_t)4095;
+}
+
+// total size of a segment for frames of the given size, 0 if it would overflow
+static inline size_t shmSegmentSize(uint32_t width, uint32_t height)
+{
+  size_t frame;
+
+  if(width == 0 || height == 0 || width > SIZE_MAX / 3 / height) return 0;
+  frame = (size_t)width * height * 3;
+  if(frame > (SIZE_MAX - shmDataOffset()) / SHM_SLOTS) return 0;
+  return shmDataOffset() + frame * SHM_SLOTS;
+}
+
+// pixels of a slot
+static inline unsigned char* shmSlot(ShmHeader* hdr, unsigned int slot)
+{
+  return (unsigned char*)hdr + hdr->dataOffset + (size_t)hdr->frameBytes * slot;
+}
+
+// map an existing segment read-only, NULL if it is missing or not ours. ino identifies the
+// segment, a producer that restarts makes a new one under the same name
+ShmHeader* shmOpen(const char* name, size_t* size, ino_t* ino);
+// show frames from a segment as they are published, returns when the window is closed
+int runShm(const char* name);
+
+#endif
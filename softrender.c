@@ -0,0 +1,436 @@
+#include "softrender.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+//bilinear weights are fixed point with this many fraction bits per axis
+#define FRAC_BITS 7
+#define FRAC_ONE (1 << FRAC_BITS)
+#define WEIGHT_SHIFT (2 * FRAC_BITS)
+
+//what is drawn outside the image, opaque black in any byte order
+static const unsigned char backgroundBytes[4] = {0, 0, 0, 255};
+
+int softImageInit(SoftImage* img, const MipChain* chain)
+{
+  size_t bytes = 0;
+  int level, x, y;
+
+  memset(img, 0, sizeof(SoftImage));
+  for(level = 0; level < chain->levels; level++) {
+    int w = chain->width[level], h = chain->height[level], stride = w + 1;
+    uint32_t* texels = malloc((size_t)stride * (h + 1) * 4);
+
+    if(texels == NULL) {
+      softImageFree(img);
+      return 0;
+    }
+    img->data[level] = texels;
+    img->width[level] = w;
+    img->height[level] = h;
+    img->stride[level] = stride;
+    img->levels = level + 1;
+
+    for(y = 0; y < h; y++) {
+      const unsigned char* src = chain->data[level] + (size_t)y * w * 3;
+      unsigned char* dst = (unsigned char*)(texels + (size_t)y * stride);
+      for(x = 0; x < w; x++) {
+        dst[x * 4] = src[x * 3];
+        dst[x * 4 + 1] = src[x * 3 + 1];
+        dst[x * 4 + 2] = src[x * 3 + 2];
+        dst[x * 4 + 3] = 255;
+      }
+      texels[(size_t)y * stride + w] = texels[(size_t)y * stride + w - 1];
+    }
+    memcpy(texels + (size_t)h * stride, texels + (size_t)(h - 1) * stride, (size_t)stride * 4);
+    bytes += (size_t)stride * (h + 1) * 4;
+  }
+  memTrack(&img->block, MEM_CPU, "cpu backend image", bytes, NULL, NULL);
+  return 1;
+}
+
+void softImageFree(SoftImage* img)
+{
+  int level;
+  memUntrack(&img->block);
+  for(level = 0; level < img->levels; level++)
+    free(img->data[level]);
+  memset(img, 0, sizeof(SoftImage));
+}
+
+int framebufferResize(Framebuffer* fb, int width, int height)
+{
+  uint32_t* pixels;
+
+  if(fb->pixels && fb->width == width && fb->height == height) return 1;
+  pixels = realloc(fb->pixels, (size_t)width * height * 4);
+  if(pixels == NULL) return 0;
+  fb->pixels = pixels;
+  fb->width = width;
+  fb->height = height;
+  memTrack(&fb->block, MEM_CPU, "cpu backend frame", (size_t)width * height * 4, NULL, NULL);
+  return 1;
+}
+
+void framebufferFree(Framebuffer* fb)
+{
+  memUntrack(&fb->block);
+  free(fb->pixels);
+  memset(fb, 0, sizeof(Framebuffer));
+}
+
+int framebufferWritePpm(const Framebuffer* fb, const char* path)
+{
+  FILE* f = fopen(path, "wb");
+  unsigned char* row;
+  int x, y, ok = 1;
+
+  if(f == NULL) return 0;
+  row = malloc((size_t)fb->width * 3);
+  if(row == NULL) {
+    fclose(f);
+    return 0;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", fb->width, fb->height);
+  for(y = 0; y < fb->height && ok; y++) {
+    const unsigned char* src = (const unsigned char*)(fb->pixels + (size_t)y * fb->width);
+    for(x = 0; x < fb->width; x++) {
+      row[x * 3] = src[x * 4];
+      row[x * 3 + 1] = src[x * 4 + 1];
+      row[x * 3 + 2] = src[x * 4 + 2];
+    }
+    ok = fwrite(row, 3, fb->width, f) == (size_t)fb->width;
+  }
+  free(row);
+  if(fclose(f) != 0) ok = 0;
+  return ok;
+}
+
+#if defined(__SSE2__)
+//one bilinear fetch. the texel and its right neighbour come in one load and are interleaved per
+//channel, so a multiply-add with the (left, right) weight pairs does the horizontal blend
+static inline __m128i bilerp(const uint32_t* p, int stride, __m128i wTop, __m128i wBottom)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i top = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), zero);
+  __m128i bottom = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p + stride)), zero);
+
+  top = _mm_unpacklo_epi16(top, _mm_srli_si128(top, 8));
+  bottom = _mm_unpacklo_epi16(bottom, _mm_srli_si128(bottom, 8));
+  return _mm_add_epi32(_mm_madd_epi16(top, wTop), _mm_madd_epi16(bottom, wBottom));
+}
+
+//four pixels of a row, i is the first. coordinates, clamping and weights are done four at a time
+static void drawSpan(const SoftJob* job, uint32_t* dst, int i, int n, float rowX, float rowY, __m128i background)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 frac = _mm_set1_ps((float)FRAC_ONE);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128i one16 = _mm_set1_epi16(FRAC_ONE);
+  const __m128i round = _mm_set1_epi32(1 << (WEIGHT_SHIFT - 1));
+  __m128 fi = _mm_add_ps(_mm_set1_ps((float)i), _mm_set_ps(3, 2, 1, 0));
+  __m128 x = _mm_add_ps(_mm_set1_ps(rowX), _mm_mul_ps(fi, _mm_set1_ps(job->dxdi)));
+  __m128 y = _mm_add_ps(_mm_set1_ps(rowY), _mm_mul_ps(fi, _mm_set1_ps(job->dydi)));
+  __m128 inside, xc, yc;
+  __m128i xi, yi, fx, fy, gx, gy, wTop, wBottom, s0, s1, s2, s3, out;
+  int xs[4], ys[4], stride = job->texStride;
+  const uint32_t* texels = job->texels;
+
+  //texel centres sit at +0.5, so the image covers [-0.5, size - 0.5)
+  inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(x, _mm_set1_ps(-0.5f)), _mm_cmplt_ps(x, _mm_set1_ps(job->texWidth - 0.5f))),
+                      _mm_and_ps(_mm_cmpge_ps(y, _mm_set1_ps(-0.5f)), _mm_cmplt_ps(y, _mm_set1_ps(job->texHeight - 0.5f))));
+  //clamping the coordinate is the same as clamping both taps to the edge
+  xc = _mm_min_ps(_mm_max_ps(x, zero), _mm_set1_ps((float)(job->texWidth - 1)));
+  yc = _mm_min_ps(_mm_max_ps(y, zero), _mm_set1_ps((float)(job->texHeight - 1)));
+  xi = _mm_cvttps_epi32(xc);
+  yi = _mm_cvttps_epi32(yc);
+  fx = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(xc, _mm_cvtepi32_ps(xi)), frac), half));
+  fy = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(yc, _mm_cvtepi32_ps(yi)), frac), half));
+
+  //the four weights per pixel, paired up as (left, right) in each 32 bit lane
+  fx = _mm_packs_epi32(fx, fx);
+  fy = _mm_packs_epi32(fy, fy);
+  gx = _mm_sub_epi16(one16, fx);
+  gy = _mm_sub_epi16(one16, fy);
+  wTop = _mm_unpacklo_epi16(_mm_mullo_epi16(gx, gy), _mm_mullo_epi16(fx, gy));
+  wBottom = _mm_unpacklo_epi16(_mm_mullo_epi16(gx, fy), _mm_mullo_epi16(fx, fy));
+
+  _mm_storeu_si128((__m128i*)xs, xi);
+  _mm_storeu_si128((__m128i*)ys, yi);
+  s0 = bilerp(texels + (size_t)ys[0] * stride + xs[0], stride, _mm_shuffle_epi32(wTop, 0x00), _mm_shuffle_epi32(wBottom, 0x00));
+  s1 = bilerp(texels + (size_t)ys[1] * stride + xs[1], stride, _mm_shuffle_epi32(wTop, 0x55), _mm_shuffle_epi32(wBottom, 0x55));
+  s2 = bilerp(texels + (size_t)ys[2] * stride + xs[2], stride, _mm_shuffle_epi32(wTop, 0xAA), _mm_shuffle_epi32(wBottom, 0xAA));
+  s3 = bilerp(texels + (size_t)ys[3] * stride + xs[3], stride, _mm_shuffle_epi32(wTop, 0xFF), _mm_shuffle_epi32(wBottom, 0xFF));
+  s0 = _mm_srli_epi32(_mm_add_epi32(s0, round), WEIGHT_SHIFT);
+  s1 = _mm_srli_epi32(_mm_add_epi32(s1, round), WEIGHT_SHIFT);
+  s2 = _mm_srli_epi32(_mm_add_epi32(s2, round), WEIGHT_SHIFT);
+  s3 = _mm_srli_epi32(_mm_add_epi32(s3, round), WEIGHT_SHIFT);
+  out = _mm_packus_epi16(_mm_packs_epi32(s0, s1), _mm_packs_epi32(s2, s3));
+  out = _mm_or_si128(_mm_and_si128(_mm_castps_si128(inside), out), _mm_andnot_si128(_mm_castps_si128(inside), background));
+
+  if(n == 4) {
+    _mm_storeu_si128((__m128i*)dst, out);
+  } else {
+    uint32_t tmp[4];
+    _mm_storeu_si128((__m128i*)tmp, out);
+    memcpy(dst, tmp, n * 4);
+  }
+}
+#else
+//blend four pixels' worth of 2x2 texel neighbourhoods. t holds t00, t10, t01, t11 and w their
+//weights, which add up to 1 << WEIGHT_SHIFT
+static void blend4(uint32_t* dst, const uint32_t t[4][4], const int16_t w[4][4])
+{
+#if defined(__ARM_NEON)
+  uint16x4_t out[4];
+  int k;
+
+  for(k = 0; k < 4; k++) {
+    uint32x4_t acc = vmull_n_u16(vget_low_u16(vmovl_u8(vcreate_u8(t[k][0]))), (uint16_t)w[k][0]);
+    acc = vmlal_n_u16(acc, vget_low_u16(vmovl_u8(vcreate_u8(t[k][1]))), (uint16_t)w[k][1]);
+    acc = vmlal_n_u16(acc, vget_low_u16(vmovl_u8(vcreate_u8(t[k][2]))), (uint16_t)w[k][2]);
+    acc = vmlal_n_u16(acc, vget_low_u16(vmovl_u8(vcreate_u8(t[k][3]))), (uint16_t)w[k][3]);
+    out[k] = vrshrn_n_u32(acc, WEIGHT_SHIFT);
+  }
+  vst1_u8((uint8_t*)dst, vmovn_u16(vcombine_u16(out[0], out[1])));
+  vst1_u8((uint8_t*)(dst + 2), vmovn_u16(vcombine_u16(out[2], out[3])));
+#else
+  int k, c;
+
+  for(k = 0; k < 4; k++) {
+    unsigned char* d = (unsigned char*)(dst + k);
+    for(c = 0; c < 4; c++) {
+      int sum = ((const unsigned char*)&t[k][0])[c] * w[k][0] + ((const unsigned char*)&t[k][1])[c] * w[k][1] +
+                ((const unsigned char*)&t[k][2])[c] * w[k][2] + ((const unsigned char*)&t[k][3])[c] * w[k][3];
+      d[c] = (unsigned char)((sum + (1 << (WEIGHT_SHIFT - 1))) >> WEIGHT_SHIFT);
+    }
+  }
+#endif
+}
+
+//four pixels of a row, i is the first
+static void drawSpan(const SoftJob* job, uint32_t* dst, int i, int n, float rowX, float rowY, uint32_t background)
+{
+  float maxX = (float)(job->texWidth - 1), maxY = (float)(job->texHeight - 1);
+  uint32_t t[4][4], out[4];
+  int16_t w[4][4];
+  int inside[4], k;
+
+  for(k = 0; k < 4; k++) {
+    float x = rowX + (i + k) * job->dxdi, y = rowY + (i + k) * job->dydi;
+    const uint32_t* p;
+    int x0, y0, fx, fy;
+
+    //texel centres sit at +0.5, so the image covers [-0.5, size - 0.5)
+    inside[k] = x >= -0.5f && x < job->texWidth - 0.5f && y >= -0.5f && y < job->texHeight - 0.5f;
+    //clamping the coordinate is the same as clamping both taps to the edge
+    x = x < 0 ? 0 : x > maxX ? maxX : x;
+    y = y < 0 ? 0 : y > maxY ? maxY : y;
+    x0 = (int)x;
+    y0 = (int)y;
+    fx = (int)((x - x0) * FRAC_ONE + 0.5f);
+    fy = (int)((y - y0) * FRAC_ONE + 0.5f);
+    p = job->texels + (size_t)y0 * job->texStride + x0;
+
+    t[k][0] = p[0];
+    t[k][1] = p[1];
+    t[k][2] = p[job->texStride];
+    t[k][3] = p[job->texStride + 1];
+    w[k][0] = (int16_t)((FRAC_ONE - fx) * (FRAC_ONE - fy));
+    w[k][1] = (int16_t)(fx * (FRAC_ONE - fy));
+    w[k][2] = (int16_t)((FRAC_ONE - fx) * fy);
+    w[k][3] = (int16_t)(fx * fy);
+  }
+
+  blend4(out, t, w);
+  for(k = 0; k < n; k++)
+    dst[k] = inside[k] ? out[k] : background;
+}
+#endif
+
+//resample one tile. the map from pixels to texels is affine, so each pixel is a multiply-add away
+static void drawTile(const void* arg, int tile)
+{
+  const SoftJob* job = arg;
+  const Framebuffer* fb = job->fb;
+  int i0 = (tile % job->tilesAcross) * SOFT_TILE, j0 = (tile / job->tilesAcross) * SOFT_TILE;
+  int i1 = i0 + SOFT_TILE < fb->width ? i0 + SOFT_TILE : fb->width;
+  int j1 = j0 + SOFT_TILE < fb->height ? j0 + SOFT_TILE : fb->height;
+  uint32_t bg;
+  int i, j;
+
+  memcpy(&bg, backgroundBytes, 4);
+  {
+#if defined(__SSE2__)
+    __m128i background = _mm_set1_epi32((int)bg);
+#else
+    uint32_t background = bg;
+#endif
+    for(j = j0; j < j1; j++) {
+      uint32_t* row = fb->pixels + (size_t)j * fb->width;
+      float rowX = job->x0 + j * job->dxdj, rowY = job->y0 + j * job->dydj;
+
+      for(i = i0; i < i1; i += 4)
+        drawSpan(job, row + i, i, i1 - i < 4 ? i1 - i : 4, rowX, rowY, background);
+    }
+  }
+}
+
+static void runTiles(SoftRenderer* r)
+{
+  int tile;
+
+  while((tile = __sync_fetch_and_add(&r->nextTile, 1)) < r->tileCount)
+    r->run(r->job, tile);
+}
+
+static void* softWorker(void* arg)
+{
+  SoftRenderer* r = arg;
+  int seen = 0;
+
+  for(;;) {
+    pthread_mutex_lock(&r->lock);
+    while(r->generation == seen && !r->quit)
+      pthread_cond_wait(&r->start, &r->lock);
+    if(r->quit) {
+      pthread_mutex_unlock(&r->lock);
+      return NULL;
+    }
+    seen = r->generation;
+    pthread_mutex_unlock(&r->lock);
+
+    runTiles(r);
+
+    pthread_mutex_lock(&r->lock);
+    if(--r->busy == 0)
+      pthread_cond_signal(&r->done);
+    pthread_mutex_unlock(&r->lock);
+  }
+}
+
+SoftRenderer* softRendererStart(int threads)
+{
+  SoftRenderer* r = calloc(1, sizeof(SoftRenderer));
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int i;
+
+  if(threads <= 0) threads = cpus > 0 ? (int)cpus : 4;
+  pthread_mutex_init(&r->lock, NULL);
+  pthread_cond_init(&r->start, NULL);
+  pthread_cond_init(&r->done, NULL);
+
+  //the calling thread draws tiles too
+  r->workers = malloc(sizeof(pthread_t) * threads);
+  for(i = 0; i < threads - 1; i++) {
+    if(pthread_create(&r->workers[r->workerCount], NULL, softWorker, r) != 0) break;
+    r->workerCount++;
+  }
+  return r;
+}
+
+void softRunTiles(SoftRenderer* r, int count, SoftTileFn run, const void* job)
+{
+  pthread_mutex_lock(&r->lock);
+  r->run = run;
+  r->job = job;
+  r->tileCount = count;
+  r->nextTile = 0;
+  r->busy = r->workerCount;
+  r->generation++;
+  pthread_cond_broadcast(&r->start);
+  pthread_mutex_unlock(&r->lock);
+
+  runTiles(r);
+
+  pthread_mutex_lock(&r->lock);
+  while(r->busy > 0)
+    pthread_cond_wait(&r->done, &r->lock);
+  pthread_mutex_unlock(&r->lock);
+}
+
+void softRendererStop(SoftRenderer* r)
+{
+  int i;
+
+  pthread_mutex_lock(&r->lock);
+  r->quit = 1;
+  pthread_cond_broadcast(&r->start);
+  pthread_mutex_unlock(&r->lock);
+  for(i = 0; i < r->workerCount; i++)
+    pthread_join(r->workers[i], NULL);
+
+  pthread_cond_destroy(&r->done);
+  pthread_cond_destroy(&r->start);
+  pthread_mutex_destroy(&r->lock);
+  free(r->workers);
+  free(r);
+}
+
+void softRender(SoftRenderer* r, Framebuffer* fb, const SoftImage* img, mat4x4 mvp, int quality)
+{
+  SoftJob job;
+  float det, nx, ny, px, py, dpxdi, dpydi, dpxdj, dpydj, rho, lod;
+  float pixelW = 2.0f / fb->width, pixelH = 2.0f / fb->height;
+  int level = 0;
+
+  if(fb->width <= 0 || fb->height <= 0) return;
+
+  //the quad spans -1..1 and only the 2D affine part of the mvp touches it, so invert that to go
+  //from a pixel back to a point on the quad
+  det = mvp[0][0] * mvp[1][1] - mvp[1][0] * mvp[0][1];
+  if(fabsf(det) < 1e-12f || img->levels == 0) {
+    uint32_t background;
+    size_t n = (size_t)fb->width * fb->height, p;
+    memcpy(&background, backgroundBytes, 4);
+    for(p = 0; p < n; p++) fb->pixels[p] = background;
+    return;
+  }
+
+  //centre of the top left pixel in normalized device coordinates
+  nx = -1 + pixelW * 0.5f - mvp[3][0];
+  ny = 1 - pixelH * 0.5f - mvp[3][1];
+  px = (mvp[1][1] * nx - mvp[1][0] * ny) / det;
+  py = (mvp[0][0] * ny - mvp[0][1] * nx) / det;
+  dpxdi = mvp[1][1] * pixelW / det;
+  dpydi = -mvp[0][1] * pixelW / det;
+  dpxdj = mvp[1][0] * pixelH / det;
+  dpydj = -mvp[0][0] * pixelH / det;
+
+  //pick the level like GL_LINEAR_MIPMAP_NEAREST, from how many level 0 texels one pixel covers
+  rho = fmaxf(hypotf(dpxdi * 0.5f * img->width[0], dpydi * 0.5f * img->height[0]),
+              hypotf(dpxdj * 0.5f * img->width[0], dpydj * 0.5f * img->height[0]));
+  lod = log2f(rho);
+  if(lod > 0) {
+    lod += samplingBias(quality, rho);
+    level = (int)(lod + 0.5f);
+    if(level < 0) level = 0;
+    if(level > img->levels - 1) level = img->levels - 1;
+  }
+
+  //quad point to texel: u = (px + 1) / 2 across, v = (1 - py) / 2 down, minus half a texel
+  job.fb = fb;
+  job.texels = img->data[level];
+  job.texWidth = img->width[level];
+  job.texHeight = img->height[level];
+  job.texStride = img->stride[level];
+  job.x0 = (px + 1) * 0.5f * job.texWidth - 0.5f;
+  job.y0 = (1 - py) * 0.5f * job.texHeight - 0.5f;
+  job.dxdi = dpxdi * 0.5f * job.texWidth;
+  job.dydi = -dpydi * 0.5f * job.texHeight;
+  job.dxdj = dpxdj * 0.5f * job.texWidth;
+  job.dydj = -dpydj * 0.5f * job.texHeight;
+  job.tilesAcross = (fb->width + SOFT_TILE - 1) / SOFT_TILE;
+  job.tileCount = job.tilesAcross * ((fb->height + SOFT_TILE - 1) / SOFT_TILE);
+
+  softRunTiles(r, job.tileCount, drawTile, &job);
+}
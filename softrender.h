@@ -0,0 +1,81 @@
+#ifndef SOFTRENDER_H
+#define SOFTRENDER_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "linmath.h"
+#include "sampling.h"
+#include "budget.h"
+
+//side of the square tiles the framebuffer is split into between threads
+#define SOFT_TILE 64
+
+//an image to draw, every mip level widened to RGBA so a texel is one 32 bit load. each level has its
+//last column and row repeated once more, so both taps of a bilinear fetch are always in bounds
+typedef struct {
+  int levels;
+  int width[MAX_MIP_LEVELS];
+  int height[MAX_MIP_LEVELS];
+  int stride[MAX_MIP_LEVELS];   //texels per row, width + 1
+  uint32_t* data[MAX_MIP_LEVELS];
+  MemBlock block;
+} SoftImage;
+
+//RGBA pixels, top row first, the layout glDrawPixels and .ppm files want (after flipping for GL)
+typedef struct {
+  int width, height;
+  uint32_t* pixels;
+  MemBlock block;
+} Framebuffer;
+
+//what one frame needs, shared by every thread drawing it
+typedef struct {
+  Framebuffer* fb;
+  const uint32_t* texels;
+  int texWidth, texHeight, texStride;
+  //texel coordinates of the centre of the top left pixel, and how they move per pixel across and down
+  float x0, y0, dxdi, dydi, dxdj, dydj;
+  int tilesAcross, tileCount;
+} SoftJob;
+
+//work on one numbered piece of a job
+typedef void (*SoftTileFn)(const void* job, int tile);
+
+//worker threads that split each frame, or any other job, into tiles
+typedef struct {
+  pthread_t* workers;
+  int workerCount;
+
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  int generation;       //bumped for every frame
+  int busy;             //workers still on the current frame
+  int quit;
+
+  SoftTileFn run;
+  const void* job;
+  int tileCount;
+  int nextTile;         //next tile to claim, taken with an atomic add
+} SoftRenderer;
+
+// copy a mip chain into RGBA levels. returns 0 if out of memory
+int softImageInit(SoftImage* img, const MipChain* chain);
+void softImageFree(SoftImage* img);
+
+int framebufferResize(Framebuffer* fb, int width, int height);
+void framebufferFree(Framebuffer* fb);
+// save as a binary .ppm
+int framebufferWritePpm(const Framebuffer* fb, const char* path);
+
+// start threads for drawing, 0 for one per core
+SoftRenderer* softRendererStart(int threads);
+void softRendererStop(SoftRenderer* r);
+// call run for tiles 0 to count - 1 spread over the threads, returns when all are done
+void softRunTiles(SoftRenderer* r, int count, SoftTileFn run, const void* job);
+// draw img through the same mvp the GL path hands its vertex shader, with bilinear filtering from the
+// nearest mip level. quality picks the LOD bias the way samplingUpdate does
+void softRender(SoftRenderer* r, Framebuffer* fb, const SoftImage* img, mat4x4 mvp, int quality);
+
+#endif
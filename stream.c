@@ -0,0 +1,314 @@
+#include "imagewindow.h"
+#include "stream.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+//while the first frame fills in, regenerate mips at most this often
+#define STREAM_MIP_INTERVAL 0.1
+
+//read more bytes after whatever is still unparsed. returns 0 at the end of the stream
+static int fillBuffer(Stream* s)
+{
+  ssize_t n;
+
+  if(s->pos > 0) {
+    memmove(s->buf, s->buf + s->pos, s->len - s->pos);
+    s->len -= s->pos;
+    s->pos = 0;
+  }
+  do {
+    n = read(s->fd, s->buf + s->len, STREAM_BUFFER - s->len);
+  } while(n < 0 && errno == EINTR);
+
+  if(n <= 0) return 0;
+  s->len += n;
+  return 1;
+}
+
+//fill dst with exactly n bytes, for rows too wide to ever fit in the read buffer
+static int readExact(Stream* s, unsigned char* dst, size_t n)
+{
+  size_t have = s->len - s->pos < n ? s->len - s->pos : n;
+
+  memcpy(dst, s->buf + s->pos, have);
+  s->pos += have;
+  while(have < n) {
+    ssize_t got = read(s->fd, dst + have, n - have);
+    if(got < 0 && errno == EINTR) continue;
+    if(got <= 0) return 0;
+    have += got;
+  }
+  return 1;
+}
+
+static void unlockMutex(void* lock)
+{
+  pthread_mutex_unlock(lock);
+}
+
+//wait on the stream's condition in a way that can be cancelled while blocked
+static void waitForViewer(Stream* s, int consumedAtLeast)
+{
+  pthread_cleanup_push(unlockMutex, &s->lock);
+  while(!s->quit && s->consumed < consumedAtLeast)
+    pthread_cond_wait(&s->changed, &s->lock);
+  pthread_cleanup_pop(0);
+}
+
+static void freeRow(void* row)
+{
+  free(*(unsigned char**)row);
+}
+
+static void* streamReader(void* arg)
+{
+  Stream* s = arg;
+  unsigned char* wide = NULL;
+  int frame = 0;
+
+  //streamClose cancels the reader, which must not leak the row buffer
+  pthread_cleanup_push(freeRow, &wide);
+  for(;;) {
+    PnmHeader hdr;
+    unsigned char* dst;
+    int result, y = 0;
+
+    //frames may be separated by stray whitespace, and the stream may end between them
+    for(;;) {
+      while(s->pos < s->len && (s->buf[s->pos] == '\n' || s->buf[s->pos] == '\r' ||
+                                s->buf[s->pos] == ' ' || s->buf[s->pos] == '\t'))
+        s->pos++;
+      result = pnmParseHeader(s->buf + s->pos, s->len - s->pos, &hdr);
+      if(result != PNM_NEED_MORE) break;
+      if(!fillBuffer(s)) {
+        if(s->len > s->pos) fprintf(stderr, "Stream ended inside a header\n");
+        goto done;
+      }
+    }
+    if(result == PNM_OK && (hdr.width > 0x7FFFFFFF || hdr.height > 0x7FFFFFFF ||
+                            (size_t)hdr.width * hdr.height > SIZE_MAX / 3))
+      result = PNM_ERR_OVERFLOW;
+    if(result != PNM_OK) {
+      fprintf(stderr, "Unable to read stream: %s\n", pnmErrorString(result));
+      goto done;
+    }
+    s->pos += hdr.offset;
+
+    pthread_mutex_lock(&s->lock);
+    //frame k reuses the buffer of frame k-2, which the viewer must have uploaded by now
+    waitForViewer(s, frame - 1);
+    if(hdr.width != (unsigned int)s->width || hdr.height != (unsigned int)s->height) {
+      //a new size replaces both buffers, so the viewer has to be done with everything
+      waitForViewer(s, frame);
+      free(s->frames[0]);
+      free(s->frames[1]);
+      s->width = (int)hdr.width;
+      s->height = (int)hdr.height;
+      s->frames[0] = calloc((size_t)s->width * s->height, 3);
+      s->frames[1] = calloc((size_t)s->width * s->height, 3);
+      memResize(&s->block, STREAM_BUFFER + (size_t)s->width * s->height * 3 * 2);
+      s->generation++;
+    }
+    if(s->quit || s->frames[0] == NULL || s->frames[1] == NULL) {
+      pthread_mutex_unlock(&s->lock);
+      goto done;
+    }
+    s->filling = frame;
+    s->rowsReady = 0;
+    dst = s->frames[frame % 2];
+    pthread_cond_broadcast(&s->changed);
+    pthread_mutex_unlock(&s->lock);
+
+    if(hdr.rowBytes > STREAM_BUFFER) {
+      unsigned char* grown = realloc(wide, hdr.rowBytes);
+      if(grown == NULL) {
+        perror("Unable to allocate a row of the stream");
+        goto done;
+      }
+      wide = grown;
+    }
+
+    while(y < s->height) {
+      size_t rowRGB = (size_t)s->width * 3;
+
+      //convert every whole row we already have
+      if(hdr.rowBytes <= STREAM_BUFFER) {
+        while(y < s->height && s->len - s->pos >= hdr.rowBytes) {
+          pnmToRgb8(dst + y * rowRGB, s->buf + s->pos, &hdr, 1);
+          s->pos += hdr.rowBytes;
+          y++;
+        }
+      } else if(readExact(s, wide, hdr.rowBytes)) {
+        pnmToRgb8(dst + y * rowRGB, wide, &hdr, 1);
+        y++;
+      } else {
+        fprintf(stderr, "Stream ended inside a frame\n");
+        goto done;
+      }
+
+      //let the viewer see the rows before we block on the next read
+      pthread_mutex_lock(&s->lock);
+      s->rowsReady = y;
+      pthread_mutex_unlock(&s->lock);
+
+      if(y < s->height && hdr.rowBytes <= STREAM_BUFFER && !fillBuffer(s)) {
+        fprintf(stderr, "Stream ended inside a frame\n");
+        goto done;
+      }
+    }
+
+    pthread_mutex_lock(&s->lock);
+    s->completed = ++frame;
+    pthread_cond_broadcast(&s->changed);
+    pthread_mutex_unlock(&s->lock);
+  }
+
+done:
+  pthread_cleanup_pop(1);
+  pthread_mutex_lock(&s->lock);
+  s->finished = 1;
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+Stream* streamOpen(int fd)
+{
+  Stream* s = calloc(1, sizeof(Stream));
+
+  s->fd = fd;
+  s->buf = malloc(STREAM_BUFFER);
+  memTrack(&s->block, MEM_CPU, "stream buffers", STREAM_BUFFER, NULL, NULL);
+  pthread_mutex_init(&s->lock, NULL);
+  pthread_cond_init(&s->changed, NULL);
+  pthread_create(&s->reader, NULL, streamReader, s);
+  return s;
+}
+
+void streamClose(Stream* s)
+{
+  pthread_mutex_lock(&s->lock);
+  s->quit = 1;
+  pthread_cond_broadcast(&s->changed);
+  pthread_mutex_unlock(&s->lock);
+
+  //the reader may be blocked in read() on a pipe that never closes
+  pthread_cancel(s->reader);
+  pthread_join(s->reader, NULL);
+
+  memUntrack(&s->block);
+  free(s->frames[0]);
+  free(s->frames[1]);
+  free(s->buf);
+  pthread_cond_destroy(&s->changed);
+  pthread_mutex_destroy(&s->lock);
+  free(s);
+}
+
+int runStream(const char* name, int fd)
+{
+  Stream* stream = streamOpen(fd);
+  ImageWindow iw;
+  MemBlock textureBlock = {0};
+  int generation = 0, uploadedRows = 0, consumed = 0, finished = 0;
+  double lastMips = 0;
+  char title[512];
+
+  //the window is sized from the first header, so wait for it
+  pthread_mutex_lock(&stream->lock);
+  while(stream->generation == 0 && !stream->finished)
+    pthread_cond_wait(&stream->changed, &stream->lock);
+  pthread_mutex_unlock(&stream->lock);
+  if(stream->generation == 0) {
+    streamClose(stream);
+    return 1;
+  }
+
+  imageWindowOpen(&iw, stream->width, stream->height, name, 1);
+
+  while (!glfwWindowShouldClose(iw.window))
+  {
+    int filling, rowsReady, completed, width, height, newGeneration;
+    unsigned char* frames[2];
+
+    //take a snapshot, the rows and frames it points at stay put until we bump consumed
+    pthread_mutex_lock(&stream->lock);
+    filling = stream->filling;
+    rowsReady = stream->rowsReady;
+    completed = stream->completed;
+    finished = stream->finished;
+    width = stream->width;
+    height = stream->height;
+    newGeneration = stream->generation;
+    frames[0] = stream->frames[0];
+    frames[1] = stream->frames[1];
+    pthread_mutex_unlock(&stream->lock);
+
+    //a new size means new storage. start it black, the reader is still writing the frame
+    if(newGeneration != generation) {
+      unsigned char* black = calloc((size_t)width * height, 3);
+      generation = newGeneration;
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, black);
+      glGenerateMipmap(GL_TEXTURE_2D);
+      free(black);
+      memTrack(&textureBlock, MEM_GPU, "stream texture", (size_t)width * height * 4 * 4 / 3, NULL, NULL);
+      uploadedRows = 0;
+      iw.view.dirty = 1;
+    }
+
+    if(completed > consumed) {
+      if(completed == 1) {
+        //finish off the first frame's last band
+        if(uploadedRows < height)
+          glTexSubImage2D(GL_TEXTURE_2D, 0, 0, uploadedRows, width, height - uploadedRows, GL_RGB,
+                          GL_UNSIGNED_BYTE, frames[0] + (size_t)uploadedRows * width * 3);
+      } else {
+        //later frames replace the whole image once they are complete. if the reader got ahead
+        //only the newest one matters
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE,
+                        frames[(completed - 1) % 2]);
+      }
+      glGenerateMipmap(GL_TEXTURE_2D);
+      uploadedRows = height;
+      consumed = completed;
+      iw.view.dirty = 1;
+
+      //hand the buffer back to the reader
+      pthread_mutex_lock(&stream->lock);
+      stream->consumed = consumed;
+      pthread_cond_broadcast(&stream->changed);
+      pthread_mutex_unlock(&stream->lock);
+
+      snprintf(title, sizeof(title), "%s - frame %d", name, completed);
+      glfwSetWindowTitle(iw.window, title);
+    } else if(filling == 0 && completed == 0 && rowsReady > uploadedRows) {
+      //the first frame is shown band by band as the rows come in
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, uploadedRows, width, rowsReady - uploadedRows, GL_RGB,
+                      GL_UNSIGNED_BYTE, frames[0] + (size_t)uploadedRows * width * 3);
+      uploadedRows = rowsReady;
+      if(glfwGetTime() - lastMips > STREAM_MIP_INTERVAL) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        lastMips = glfwGetTime();
+      }
+      iw.view.dirty = 1;
+    }
+
+    if(iw.view.dirty) {
+      iw.view.dirty = 0;
+      drawImageView(iw.window, &iw.view, &iw.prog, &iw.sampling, iw.texID, width, height);
+      glfwPollEvents();
+    } else if(finished) {
+      glfwWaitEvents();
+    } else {
+      glfwWaitEventsTimeout(1.0 / 60);
+    }
+  }
+
+  streamClose(stream);
+  memUntrack(&textureBlock);
+  imageWindowClose(&iw);
+  return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <pthread.h>
+#include "pnm.h"
+#include "budget.h"
+
+#define STREAM_BUFFER (256 * 1024)
+
+//a P6 (or P5) stream read from a pipe on a background thread, one or more frames back to back
+typedef struct {
+  int fd;
+  unsigned char* buf;       //bytes read from fd but not parsed yet live in buf[pos, len)
+  size_t pos, len;
+
+  pthread_t reader;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+
+  //everything below is shared with the viewer and guarded by lock
+  int width, height;
+  int generation;           //bumped whenever the frame size changes
+  unsigned char* frames[2]; //frame k is decoded into frames[k % 2] as 8 bit RGB
+  int filling;              //frame being read
+  int rowsReady;            //rows of that frame decoded so far
+  int completed;            //frames fully read
+  int consumed;             //frames the viewer has finished with
+  int finished;             //end of stream, or an error
+  int quit;
+  MemBlock block;
+} Stream;
+
+// start reading frames from fd
+Stream* streamOpen(int fd);
+void streamClose(Stream* stream);
+// show a stream in a window, filling the first frame in as it arrives. returns when closed
+int runStream(const char* name, int fd);
+
+#endif
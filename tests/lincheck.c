@@ -0,0 +1,154 @@
+//checks that the SSE/NEON versions in linmath.h give the same answers as the plain C ones.
+//both come from tests/linops.c, built with and without LINMATH_SIMD
+#include "linops.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUNDS 1000
+#define MAX_BATCH 13
+//the vector versions add in a different order, so the last bits may differ
+#define TOLERANCE 1e-5f
+
+static const LinmathOps* scalar = &linmathOpsScalar;
+static const LinmathOps* simd = &linmathOpsSimd;
+static int failures;
+
+static float randomFloat(void)
+{
+  return (float)rand() / RAND_MAX * 20.0f - 10.0f;
+}
+
+static void randomFloats(float* f, int count)
+{
+  int i;
+  for(i = 0; i < count; i++)
+    f[i] = randomFloat();
+}
+
+//relative to the larger value, absolute near zero
+static int nearlyEqual(float a, float b)
+{
+  float scale = fmaxf(1.0f, fmaxf(fabsf(a), fabsf(b)));
+  return fabsf(a - b) <= TOLERANCE * scale;
+}
+
+static void compare(const char* what, int round, const float* expected, const float* got, int count)
+{
+  int i;
+  for(i = 0; i < count; i++) {
+    if(!nearlyEqual(expected[i], got[i])) {
+      //the first bad element of a call is enough to go on
+      if(failures++ < 20)
+        fprintf(stderr, "%s, round %d: element %d is %g in C and %g with SIMD\n", what, round, i, expected[i], got[i]);
+      return;
+    }
+  }
+}
+
+static void checkMatrices(int round)
+{
+  float a[4][4], b[4][4], want[4][4], got[4][4];
+  float k = randomFloat(), x = randomFloat(), y = randomFloat(), z = randomFloat();
+
+  randomFloats(&a[0][0], 16);
+  randomFloats(&b[0][0], 16);
+
+  scalar->add(want, a, b);
+  simd->add(got, a, b);
+  compare("mat4x4_add", round, &want[0][0], &got[0][0], 16);
+
+  scalar->sub(want, a, b);
+  simd->sub(got, a, b);
+  compare("mat4x4_sub", round, &want[0][0], &got[0][0], 16);
+
+  scalar->scale(want, a, k);
+  simd->scale(got, a, k);
+  compare("mat4x4_scale", round, &want[0][0], &got[0][0], 16);
+
+  scalar->mul(want, a, b);
+  simd->mul(got, a, b);
+  compare("mat4x4_mul", round, &want[0][0], &got[0][0], 16);
+
+  //the result written over either input, the way M = M * R is used
+  memcpy(got, a, sizeof(got));
+  simd->mul(got, got, b);
+  compare("mat4x4_mul with M == a", round, &want[0][0], &got[0][0], 16);
+
+  memcpy(got, b, sizeof(got));
+  simd->mul(got, a, got);
+  compare("mat4x4_mul with M == b", round, &want[0][0], &got[0][0], 16);
+
+  memcpy(want, a, sizeof(want));
+  memcpy(got, a, sizeof(got));
+  scalar->translateInPlace(want, x, y, z);
+  simd->translateInPlace(got, x, y, z);
+  compare("mat4x4_translate_in_place", round, &want[0][0], &got[0][0], 16);
+}
+
+static void checkVectors(int round)
+{
+  float M[4][4], v[4], want[4], got[4], p[4], q[4];
+
+  randomFloats(&M[0][0], 16);
+  randomFloats(v, 4);
+  randomFloats(p, 4);
+  randomFloats(q, 4);
+
+  scalar->mulVec4(want, M, v);
+  simd->mulVec4(got, M, v);
+  compare("mat4x4_mul_vec4", round, want, got, 4);
+
+  scalar->quatMul(want, p, q);
+  simd->quatMul(got, p, q);
+  compare("quat_mul", round, want, got, 4);
+}
+
+//every count up to MAX_BATCH, so the ones that are not a multiple of 4 are covered too
+static void checkBatch(int round)
+{
+  float M[4][4], in[MAX_BATCH][4], want[MAX_BATCH][4], got[MAX_BATCH][4];
+  char what[64];
+  int n;
+
+  randomFloats(&M[0][0], 16);
+  for(n = 0; n <= MAX_BATCH; n++) {
+    randomFloats(&in[0][0], MAX_BATCH * 4);
+    //past n the output must be left alone
+    memset(want, 0, sizeof(want));
+    memset(got, 0, sizeof(got));
+    scalar->mulVec4Batch(want, M, (float const (*)[4])in, n);
+    simd->mulVec4Batch(got, M, (float const (*)[4])in, n);
+    snprintf(what, sizeof(what), "mat4x4_mul_vec4_batch of %d", n);
+    compare(what, round, &want[0][0], &got[0][0], MAX_BATCH * 4);
+
+    //out == in
+    memcpy(got, in, sizeof(got));
+    simd->mulVec4Batch(got, M, (float const (*)[4])got, n);
+    memcpy(want, in, sizeof(want));
+    scalar->mulVec4Batch(want, M, (float const (*)[4])want, n);
+    snprintf(what, sizeof(what), "mat4x4_mul_vec4_batch of %d in place", n);
+    compare(what, round, &want[0][0], &got[0][0], MAX_BATCH * 4);
+  }
+}
+
+int main(void)
+{
+  int round;
+
+  srand(1);
+  for(round = 0; round < ROUNDS; round++) {
+    checkMatrices(round);
+    checkVectors(round);
+    checkBatch(round);
+  }
+
+  if(failures) {
+    fprintf(stderr, "%d mismatches between the C and SIMD versions of linmath.h\n", failures);
+    return 1;
+  }
+  printf("linmath.h: C and SIMD versions agree over %d rounds\n", ROUNDS);
+  return 0;
+}
@@ -0,0 +1,18 @@
+//built once as linmathOpsScalar and once as linmathOpsSimd, see the makefile
+#include "linops.h"
+#include "../linmath.h"
+
+#ifndef LINOPS_NAME
+#error define LINOPS_NAME to the table this copy should be built as
+#endif
+
+static void add(mat4x4 M, mat4x4 a, mat4x4 b) { mat4x4_add(M, a, b); }
+static void sub(mat4x4 M, mat4x4 a, mat4x4 b) { mat4x4_sub(M, a, b); }
+static void scale(mat4x4 M, mat4x4 a, float k) { mat4x4_scale(M, a, k); }
+static void mul(mat4x4 M, mat4x4 a, mat4x4 b) { mat4x4_mul(M, a, b); }
+static void mulVec4(vec4 r, mat4x4 M, vec4 v) { mat4x4_mul_vec4(r, M, v); }
+static void translateInPlace(mat4x4 M, float x, float y, float z) { mat4x4_translate_in_place(M, x, y, z); }
+static void mulVec4Batch(vec4* out, mat4x4 M, vec4 const* in, int n) { mat4x4_mul_vec4_batch(out, M, in, n); }
+static void quatMul(quat r, quat p, quat q) { quat_mul(r, p, q); }
+
+const LinmathOps LINOPS_NAME = {add, sub, scale, mul, mulVec4, translateInPlace, mulVec4Batch, quatMul};
@@ -0,0 +1,20 @@
+#ifndef LINOPS_H
+#define LINOPS_H
+
+//the linmath routines that have vector versions, wrapped so one build can call the other's
+typedef struct {
+  void (*add)(float M[4][4], float a[4][4], float b[4][4]);
+  void (*sub)(float M[4][4], float a[4][4], float b[4][4]);
+  void (*scale)(float M[4][4], float a[4][4], float k);
+  void (*mul)(float M[4][4], float a[4][4], float b[4][4]);
+  void (*mulVec4)(float r[4], float M[4][4], float v[4]);
+  void (*translateInPlace)(float M[4][4], float x, float y, float z);
+  void (*mulVec4Batch)(float (*out)[4], float M[4][4], float const (*in)[4], int n);
+  void (*quatMul)(float r[4], float p[4], float q[4]);
+} LinmathOps;
+
+// linops.c is built twice, with and without LINMATH_SIMD, to give these two
+extern const LinmathOps linmathOpsScalar;
+extern const LinmathOps linmathOpsSimd;
+
+#endif
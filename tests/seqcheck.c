@@ -0,0 +1,135 @@
+//seeks all over a sequence while its workers are decoding, and checks every frame the viewer would
+//upload holds that frame's pixels and nothing of another one
+#include "../sequence.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAMES 40
+//16 bit graymaps, so decoding takes long enough to still be going when the playhead jumps
+#define SIZE 512
+#define SECONDS 2.0
+
+static char dir[] = "/tmp/ezview-seqcheckXXXXXX";
+
+static unsigned char frameValue(int frame)
+{
+  return (unsigned char)(frame * 37 + 11);
+}
+
+static double seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int writeFrames(void)
+{
+  static unsigned char row[SIZE * 2];
+  char path[256];
+  int frame, x, y;
+
+  for(frame = 0; frame < FRAMES; frame++) {
+    FILE* f;
+    snprintf(path, sizeof(path), "%s/f%03d.pgm", dir, frame);
+    f = fopen(path, "wb");
+    if(f == NULL) return 0;
+    fprintf(f, "P5\n%d %d\n65535\n", SIZE, SIZE);
+    //257 * v converts back to exactly v
+    for(x = 0; x < SIZE * 2; x++)
+      row[x] = frameValue(frame);
+    for(y = 0; y < SIZE; y++)
+      fwrite(row, 1, sizeof(row), f);
+    if(fclose(f) != 0) return 0;
+  }
+  return 1;
+}
+
+static void removeFrames(void)
+{
+  char path[256];
+  int frame;
+
+  for(frame = 0; frame < FRAMES; frame++) {
+    snprintf(path, sizeof(path), "%s/f%03d.pgm", dir, frame);
+    unlink(path);
+  }
+  rmdir(dir);
+}
+
+//the frames the workers are decoding towards can't be taken from under the viewer until the next
+//seek, which only this thread makes. so a ready one has to be whole and stay whole while it is read
+static int checkReady(Sequence* seq)
+{
+  size_t bytes = (size_t)SIZE * SIZE * 3, i;
+  int k, bad = 0;
+
+  for(k = 0; k < seq->depth; k++) {
+    int frame = (seq->playhead + k) % seq->count, ready;
+    SeqSlot* slot = &seq->ring[frame % SEQ_RING];
+
+    pthread_mutex_lock(&seq->lock);
+    ready = slot->frame == frame && slot->state == SLOT_READY;
+    pthread_mutex_unlock(&seq->lock);
+    if(!ready) continue;
+
+    //read outside the lock, the way the upload does
+    for(i = 0; i < bytes; i++) {
+      if(slot->pixels[i] != frameValue(frame)) {
+        fprintf(stderr, "frame %d is ready but byte %zu is %d, not %d\n", frame, i, slot->pixels[i],
+                frameValue(frame));
+        bad = 1;
+        break;
+      }
+    }
+  }
+  return bad;
+}
+
+int main(void)
+{
+  char pattern[256];
+  Sequence* seq;
+  double end;
+  int seeks = 0, failures = 0;
+
+  if(mkdtemp(dir) == NULL) {
+    perror("Unable to make a directory for the frames");
+    return 1;
+  }
+  if(!writeFrames()) {
+    perror("Unable to write the frames");
+    removeFrames();
+    return 1;
+  }
+  snprintf(pattern, sizeof(pattern), "%s/f%%03d.pgm", dir);
+  seq = sequenceOpen(pattern, 24);
+  if(seq == NULL) {
+    removeFrames();
+    return 1;
+  }
+
+  srand(1);
+  end = seconds() + SECONDS;
+  while(seconds() < end && failures < 5) {
+    //mostly short hops like [ and ], sometimes a jump across the whole sequence
+    if(rand() % 4) sequenceSeek(seq, seq->playhead + rand() % 21 - 10);
+    else sequenceSeek(seq, rand() % FRAMES);
+    seeks++;
+    usleep(rand() % 3000);
+    failures += checkReady(seq);
+  }
+
+  sequenceClose(seq);
+  removeFrames();
+  if(failures) {
+    fprintf(stderr, "%d torn frames after %d seeks\n", failures, seeks);
+    return 1;
+  }
+  printf("sequence: no torn frames after %d seeks\n", seeks);
+  return 0;
+}